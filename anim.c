@@ -0,0 +1,133 @@
+/*
+ * anim.c
+ * sprite animations described as tables, with each sprite's current frame
+ * copied into its own slot of sprite VRAM
+ */
+
+#include "anim.h"
+#include "dma.h"
+
+/* the words in one 4bpp 8x8 tile */
+#define ANIM_TILE_WORDS (ANIM_TILE_BYTES / 4)
+
+void anim_init(struct Animator* animator, const unsigned int* sheet,
+        volatile unsigned int* vram, struct DmaQueue* queue, struct TimerWheel* timers) {
+    animator->sheet = sheet;
+    animator->vram = vram;
+    animator->queue = queue;
+    animator->timers = timers;
+    animator->count = 0;
+    animator->bytes_last = 0;
+    animator->bytes_max = 0;
+    animator->bytes_total = 0;
+    animator->refused = 0;
+    animator->spare.timers = timers;
+    timer_init(&animator->spare.timer, 0, 0);
+    anim_clear(animator);
+}
+
+void anim_clear(struct Animator* animator) {
+    for (int i = 0; i < animator->count; i++) {
+        timer_cancel(&animator->animations[i].timer);
+    }
+    timer_cancel(&animator->spare.timer);
+    animator->count = 0;
+    animator->next_slot = 0;
+}
+
+const struct AnimFrame* anim_frame(const struct Animation* animation) {
+    return &animation->clip->frames[animation->frame];
+}
+
+/* show the frame the animation is on, and time how long it stays up - a frame
+ * with no duration stays up, so it needs no timer */
+static void anim_show(struct Animation* animation) {
+    animation->changed = 1;
+    animation->dirty = 1;
+
+    int duration = anim_frame(animation)->duration;
+    if (duration != 0) {
+        timer_add(animation->timers, &animation->timer, duration);
+    } else {
+        timer_cancel(&animation->timer);
+    }
+}
+
+/* move on to the next frame once the last one's time is up */
+static void anim_next(void* data) {
+    struct Animation* animation = (struct Animation*) data;
+    animation->frame++;
+    if (animation->frame >= animation->clip->count) {
+        animation->frame = 0;
+    }
+    anim_show(animation);
+}
+
+struct Animation* anim_add(struct Animator* animator, int tiles, const struct AnimClip* clip) {
+    if (animator->count == MAX_ANIMATIONS || animator->next_slot + tiles > ANIM_VRAM_TILES) {
+        animator->refused++;
+        return 0;
+    }
+
+    struct Animation* animation = &animator->animations[animator->count++];
+    animation->sprite = 0;
+    animation->clip = clip;
+    animation->frame = 0;
+    animation->slot = animator->next_slot;
+    animation->tiles = tiles;
+    animation->timers = animator->timers;
+    timer_init(&animation->timer, anim_next, animation);
+    anim_show(animation);
+
+    animator->next_slot += tiles;
+    return animation;
+}
+
+struct Animation* anim_spare(struct Animator* animator, const struct AnimClip* clip) {
+    struct Animation* animation = &animator->spare;
+    animation->sprite = 0;
+    animation->clip = clip;
+    animation->frame = 0;
+    animation->slot = 0;
+    animation->tiles = 0;
+    timer_cancel(&animation->timer);
+    timer_init(&animation->timer, anim_next, animation);
+    anim_show(animation);
+    return animation;
+}
+
+void anim_play(struct Animation* animation, const struct AnimClip* clip) {
+    if (animation->clip == clip) {
+        return;
+    }
+    animation->clip = clip;
+    animation->frame = 0;
+    anim_show(animation);
+}
+
+void anim_queue(struct Animator* animator) {
+    unsigned int bytes = 0;
+
+    for (int i = 0; i < animator->count; i++) {
+        struct Animation* animation = &animator->animations[i];
+        if (!animation->dirty) {
+            continue;
+        }
+
+        /* a frame's tiles are next to each other in the sheet, as 1D mapping
+         * wants them in the slot - if the queue is full it stays dirty and
+         * goes next frame */
+        const unsigned int* source = animator->sheet + anim_frame(animation)->tile * ANIM_TILE_WORDS;
+        volatile unsigned int* dest = animator->vram + animation->slot * ANIM_TILE_WORDS;
+        if (dma_queue_add(animator->queue, dest, source, animation->tiles * ANIM_TILE_BYTES)) {
+            animation->dirty = 0;
+            bytes += animation->tiles * ANIM_TILE_BYTES;
+        }
+    }
+
+    animator->bytes_last = bytes;
+    if (bytes > animator->bytes_max) {
+        animator->bytes_max = bytes;
+    }
+    animator->bytes_total += bytes;
+}
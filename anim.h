@@ -0,0 +1,130 @@
+/*
+ * anim.h
+ * sprite animations described as tables, with each sprite's current frame
+ * copied into its own slot of sprite VRAM
+ */
+
+#pragma once
+#ifndef ANIM_H
+#define ANIM_H
+
+#include "timer.h"
+
+/* the flip flags a frame can have */
+#define ANIM_FLIP_H (1 << 0)
+#define ANIM_FLIP_V (1 << 1)
+
+/* the bytes in one 4bpp 8x8 tile */
+#define ANIM_TILE_BYTES 32
+
+/* the most sprites which can be animated at once */
+#define MAX_ANIMATIONS 32
+
+/* the tiles of sprite VRAM the slots are given out of */
+#define ANIM_VRAM_TILES 1024
+
+/* one frame of a clip: the first of its tiles in the sprite sheet, the number
+ * of game frames it is shown for (0 shows it until the clip changes), and how
+ * it is flipped */
+struct AnimFrame {
+    unsigned short tile;
+    unsigned char duration;
+    unsigned char flags;
+};
+
+/* a list of frames played over and over */
+struct AnimClip {
+    const struct AnimFrame* frames;
+    int count;
+};
+
+/* make a clip out of an array of frames */
+#define ANIM_CLIP(frames) {frames, sizeof(frames) / sizeof(frames[0])}
+
+struct Sprite;
+struct DmaQueue;
+
+/* a sprite playing a clip - the sprite always shows the tiles of its slot, and
+ * when the frame changes the new frame's tiles are copied over the old ones */
+struct Animation {
+    struct Sprite* sprite;
+
+    const struct AnimClip* clip;
+
+    /* which frame of the clip is showing, and the timer for when it is up -
+     * the timer isn't running for a frame which stays up */
+    int frame;
+    struct Timer timer;
+    struct TimerWheel* timers;
+
+    /* the first tile of this sprite's slot in VRAM, and how many it holds */
+    int slot;
+    int tiles;
+
+    /* the frame changed, so the sprite needs its flips and palette bank set
+     * again */
+    int changed;
+
+    /* the frame's tiles have not been queued for the slot yet */
+    int dirty;
+};
+
+/* every animated sprite, along with where their frames come from and go to */
+struct Animator {
+    /* the 4bpp sprite sheet in ROM */
+    const unsigned int* sheet;
+
+    /* the start of sprite tile memory, and the queue the copies to it go on */
+    volatile unsigned int* vram;
+    struct DmaQueue* queue;
+
+    /* the wheel the frame timers run on */
+    struct TimerWheel* timers;
+
+    struct Animation animations[MAX_ANIMATIONS];
+    int count;
+
+    /* handed out by anim_spare to anything turned away - it is never queued,
+     * so its frames are never copied anywhere */
+    struct Animation spare;
+
+    /* the first VRAM tile not yet given to a slot */
+    int next_slot;
+
+    /* the animations turned away because there was no room for them, in the
+     * table or in VRAM */
+    unsigned long refused;
+
+    /* the bytes queued for VRAM at the last frame, the most at any one, and in total */
+    unsigned int bytes_last;
+    unsigned int bytes_max;
+    unsigned long bytes_total;
+};
+
+/* set up an animator which copies frames out of sheet into vram with a queue,
+ * and times them with a timer wheel */
+void anim_init(struct Animator* animator, const unsigned int* sheet,
+        volatile unsigned int* vram, struct DmaQueue* queue, struct TimerWheel* timers);
+
+/* take away all of the animations and their slots */
+void anim_clear(struct Animator* animator);
+
+/* start a new animation of frames tiles big playing clip, giving it a VRAM
+ * slot - the sprite using it should show the slot's tiles and be set afterwards.
+ * returns 0 if there are already MAX_ANIMATIONS or the slot won't fit */
+struct Animation* anim_add(struct Animator* animator, int tiles, const struct AnimClip* clip);
+
+/* the spare animation, set to play clip, for something anim_add turned away -
+ * everything given it shares the one */
+struct Animation* anim_spare(struct Animator* animator, const struct AnimClip* clip);
+
+/* switch to a clip, starting it from the top unless it is already playing */
+void anim_play(struct Animation* animation, const struct AnimClip* clip);
+
+/* the frame of the clip being shown */
+const struct AnimFrame* anim_frame(const struct Animation* animation);
+
+/* queue up copies of the tiles of each frame which changed into its slot */
+void anim_queue(struct Animator* animator);
+
+#endif
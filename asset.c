@@ -0,0 +1,25 @@
+/*
+ * asset.c
+ * loads the compressed graphics made by assetconv
+ */
+
+#include "asset.h"
+
+/* the BIOS decompressors, in decompress.s - these write whole halfwords so they
+ * can unpack into VRAM and palette memory */
+void lz77_uncomp_vram(const void* source, volatile void* dest);
+void rl_uncomp_vram(const void* source, volatile void* dest);
+
+unsigned int asset_load(volatile void* dest, const unsigned int* asset) {
+    switch (asset[0] & 0xf0) {
+        case ASSET_LZ77:
+            lz77_uncomp_vram(asset, dest);
+            break;
+        case ASSET_RL:
+            rl_uncomp_vram(asset, dest);
+            break;
+        default:
+            return 0;
+    }
+    return ASSET_SIZE(asset);
+}
@@ -0,0 +1,21 @@
+/*
+ * asset.h
+ * loads the compressed graphics made by assetconv
+ */
+
+#pragma once
+#ifndef ASSET_H
+#define ASSET_H
+
+/* the compression type in the low byte of a blob's header */
+#define ASSET_LZ77 0x10
+#define ASSET_RL 0x30
+
+/* the number of bytes a blob unpacks to, from the high bytes of its header */
+#define ASSET_SIZE(asset) ((asset)[0] >> 8)
+
+/* unpack a blob straight into VRAM or palette memory, returns the number of
+ * bytes written (0 if the blob isn't one the BIOS can unpack) */
+unsigned int asset_load(volatile void* dest, const unsigned int* asset);
+
+#endif
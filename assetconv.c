@@ -0,0 +1,584 @@
+/*
+ * assetconv.c
+ * host tool which packs the graphics into blobs the GBA BIOS can decompress
+ *
+ * build and run from the top of the project with:
+ *   gcc -O2 -o assetconv assetconv.c map.c && ./assetconv
+ * this converts the 256 color images to 16 color tiles, merging background tiles
+ * which are the same when flipped, and builds the world map out of the forest.
+ * it writes one blob per asset into assets/, along with assets.s which puts
+ * them into the ROM and assets.h which declares them
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the png2gba and tile editor output the assets are made from */
+#include "GBAProjectBackground1.h"
+#include "Sprites.h"
+#include "ForestBackground.h"
+
+/* which tiles are solid, so merging tiles can't change how the map acts, and
+ * building the world's collision bits */
+#include "map.h"
+
+/* the compression types, stored in the low byte of the header as the BIOS
+ * expects (the high three bytes are the unpacked size) */
+#define ASSET_LZ77 0x10
+#define ASSET_RL 0x30
+
+/* the back references LZ77 can encode - a distance of 1 is left out since the
+ * VRAM version of the decompressor writes two bytes at a time, and the byte just
+ * before the one being written may not have been stored yet */
+#define LZ77_MIN_LENGTH 3
+#define LZ77_MAX_LENGTH 18
+#define LZ77_MIN_DISTANCE 2
+#define LZ77_MAX_DISTANCE 4096
+
+/* the lengths of repeated and copied runs RL can encode */
+#define RL_MIN_RUN 3
+#define RL_MAX_RUN 130
+#define RL_MAX_COPY 128
+
+/* the largest asset, and the most a compressor can ever grow one by */
+#define MAX_ASSET_SIZE 0x10000
+#define MAX_PACKED_SIZE (MAX_ASSET_SIZE + MAX_ASSET_SIZE / 8 + 16)
+
+/* tiles are 8x8 pixels - the images have a byte per pixel, and the converted
+ * tiles have 4 bits per pixel picking a color from one 16 color palette bank */
+#define TILE_PIXELS 64
+#define TILE_BYTES_8BPP 64
+#define TILE_BYTES_4BPP 32
+#define MAX_TILES 1024
+
+/* the palette banks, color 0 of each one is transparent */
+#define NUM_BANKS 16
+#define BANK_COLORS 16
+
+/* the parts of a background map entry */
+#define ENTRY_TILE 0x3ff
+#define ENTRY_FLIP_H (1 << 10)
+#define ENTRY_FLIP_V (1 << 11)
+#define ENTRY_FLIPS (ENTRY_FLIP_H | ENTRY_FLIP_V)
+#define ENTRY_BANK_SHIFT 12
+
+/* the world is this many copies of the forest map across and down */
+#define WORLD_BLOCKS 8
+#define WORLD_WIDTH (ForestBackground_width * WORLD_BLOCKS)
+#define WORLD_HEIGHT (ForestBackground_height * WORLD_BLOCKS)
+
+/* each 16x16 sprite frame is 4 tiles in a row which have to share a bank, since
+ * the palette bank is set for the whole sprite */
+#define SPRITE_FRAME_TILES 4
+
+/* a set of tiles with no two the same, even when flipped */
+struct TileSet {
+    int count;
+    unsigned char pixels[MAX_TILES][TILE_PIXELS];
+    unsigned char bank[MAX_TILES];
+};
+
+/* a 256 color palette being split into banks - each slot holds the image color
+ * it stands for */
+struct Banks {
+    int count;
+    int used[NUM_BANKS];
+    unsigned char colors[NUM_BANKS][BANK_COLORS];
+};
+
+/* the converted background */
+static struct TileSet background_set;
+static struct Banks background_banks;
+static unsigned short background_palette[256];
+static unsigned char background_tiles[MAX_TILES * TILE_BYTES_4BPP];
+static unsigned short background_map[ForestBackground_width * ForestBackground_height];
+
+/* the world, and which of its tiles are solid */
+static unsigned short world_map[WORLD_WIDTH * WORLD_HEIGHT];
+static unsigned int world_rows[WORLD_HEIGHT * WORLD_WIDTH / 32];
+static unsigned int world_columns[WORLD_WIDTH * WORLD_HEIGHT / 32];
+
+/* the converted sprites, and the bank for each of their tiles */
+static struct TileSet sprite_set;
+static struct Banks sprite_banks;
+static unsigned short sprite_palette[256];
+static unsigned char sprite_tiles[MAX_TILES * TILE_BYTES_4BPP];
+
+/* something to put into the ROM, along with the bytes of VRAM (or palette
+ * memory) it took up before being converted */
+struct Asset {
+    const char* name;
+    const char* comment;
+    const void* data;
+    int size;
+    int original_size;
+};
+
+/* flip the pixels of a tile across, down, or both */
+static void flip_tile(const unsigned char* in, int flips, unsigned char* out) {
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            int fx = (flips & ENTRY_FLIP_H) ? 7 - x : x;
+            int fy = (flips & ENTRY_FLIP_V) ? 7 - y : y;
+            out[y * 8 + x] = in[fy * 8 + fx];
+        }
+    }
+}
+
+/* find a tile in the set which matches, possibly once flipped - returns its
+ * number and sets the flips which turn it into this one, or -1 if none do */
+static int find_tile(const struct TileSet* set, const unsigned char* pixels, int* flips) {
+    static const int tries[4] = {0, ENTRY_FLIP_H, ENTRY_FLIP_V, ENTRY_FLIPS};
+    unsigned char flipped[TILE_PIXELS];
+
+    for (int t = 0; t < 4; t++) {
+        flip_tile(pixels, tries[t], flipped);
+        for (int i = 0; i < set->count; i++) {
+            if (memcmp(set->pixels[i], flipped, TILE_PIXELS) == 0) {
+                *flips = tries[t];
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/* put a tile into the set, returns its number */
+static int add_tile(struct TileSet* set, const unsigned char* pixels) {
+    if (set->count == MAX_TILES) {
+        fprintf(stderr, "assetconv: more than %d tiles\n", MAX_TILES);
+        exit(1);
+    }
+    memcpy(set->pixels[set->count], pixels, TILE_PIXELS);
+    return set->count++;
+}
+
+/* which slot of a bank holds an image color, or -1 if it doesn't have it */
+static int bank_slot(const struct Banks* banks, int bank, int color) {
+    if (color == 0) {
+        return 0;
+    }
+    for (int slot = 1; slot < banks->used[bank]; slot++) {
+        if (banks->colors[bank][slot] == color) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/* pick a bank with room for all the colors in count pixels, preferring the one
+ * which has most of them already, and add the ones it is missing */
+static int assign_bank(struct Banks* banks, const unsigned char* pixels, int count) {
+    unsigned char present[256] = {0};
+    for (int i = 0; i < count; i++) {
+        present[pixels[i]] = 1;
+    }
+    present[0] = 0;
+
+    int best = -1;
+    int best_shared = -1;
+    for (int bank = 0; bank < banks->count; bank++) {
+        int shared = 0;
+        int missing = 0;
+        for (int color = 1; color < 256; color++) {
+            if (present[color]) {
+                if (bank_slot(banks, bank, color) > 0) {
+                    shared++;
+                } else {
+                    missing++;
+                }
+            }
+        }
+        if (banks->used[bank] + missing <= BANK_COLORS && shared > best_shared) {
+            best = bank;
+            best_shared = shared;
+        }
+    }
+
+    if (best < 0) {
+        if (banks->count == NUM_BANKS) {
+            fprintf(stderr, "assetconv: too many colors for %d palette banks\n", NUM_BANKS);
+            exit(1);
+        }
+        best = banks->count++;
+        banks->used[best] = 1;
+    }
+
+    for (int color = 1; color < 256; color++) {
+        if (present[color] && bank_slot(banks, best, color) < 0) {
+            if (banks->used[best] == BANK_COLORS) {
+                fprintf(stderr, "assetconv: a tile has more than %d colors\n", BANK_COLORS - 1);
+                exit(1);
+            }
+            banks->colors[best][banks->used[best]++] = color;
+        }
+    }
+    return best;
+}
+
+/* lay the original colors out into the banks */
+static void build_palette(const struct Banks* banks, const unsigned short* original,
+        unsigned short* palette) {
+    memset(palette, 0, 256 * sizeof(unsigned short));
+
+    /* the first color is the backdrop behind everything */
+    palette[0] = original[0];
+    for (int bank = 0; bank < banks->count; bank++) {
+        for (int slot = 1; slot < banks->used[bank]; slot++) {
+            palette[bank * BANK_COLORS + slot] = original[banks->colors[bank][slot]];
+        }
+    }
+}
+
+/* write the set out as 4bpp tiles, two pixels a byte with the left one in the
+ * low half, returns the number of bytes */
+static int write_4bpp(const struct TileSet* set, const struct Banks* banks, unsigned char* out) {
+    for (int i = 0; i < set->count; i++) {
+        for (int p = 0; p < TILE_PIXELS; p += 2) {
+            int left = bank_slot(banks, set->bank[i], set->pixels[i][p]);
+            int right = bank_slot(banks, set->bank[i], set->pixels[i][p + 1]);
+            out[i * TILE_BYTES_4BPP + p / 2] = left | (right << 4);
+        }
+    }
+    return set->count * TILE_BYTES_4BPP;
+}
+
+/* boil the background tiles down to the ones which differ even when flipped, and
+ * point the map at them with flip bits - map entries past the end of the image
+ * were always empty, so they get an empty tile */
+static void convert_background() {
+    int source_count = sizeof(GBAProjectBackground1_data) / TILE_BYTES_8BPP;
+    int remap[MAX_TILES];
+
+    for (int t = 0; t < source_count; t++) {
+        const unsigned char* pixels = GBAProjectBackground1_data + t * TILE_BYTES_8BPP;
+        int flips = 0;
+        int tile = find_tile(&background_set, pixels, &flips);
+        if (tile < 0) {
+            tile = add_tile(&background_set, pixels);
+        }
+        remap[t] = tile | flips;
+    }
+
+    unsigned char empty_pixels[TILE_PIXELS] = {0};
+    int empty = -1;
+    for (int i = 0; i < ForestBackground_width * ForestBackground_height; i++) {
+        int tile = ForestBackground[i] & ENTRY_TILE;
+        int entry;
+        if (tile < source_count) {
+            entry = remap[tile];
+        } else {
+            if (empty < 0) {
+                int flips = 0;
+                empty = find_tile(&background_set, empty_pixels, &flips);
+                if (empty < 0) {
+                    empty = add_tile(&background_set, empty_pixels);
+                }
+            }
+            entry = empty;
+        }
+
+        /* any flips the map already had go on top of the ones from merging */
+        background_map[i] = entry ^ (ForestBackground[i] & ENTRY_FLIPS);
+
+        /* the collision code goes by tile number, so a tile can't change number
+         * or be merged into one which acts differently */
+        if (tile_properties[entry & ENTRY_TILE] != tile_properties[tile]) {
+            fprintf(stderr, "assetconv: background tile %d became %d, update tile_properties in map.c\n",
+                    tile, entry & ENTRY_TILE);
+            exit(1);
+        }
+    }
+
+    /* each tile gets whichever bank it fits best, then the map says which */
+    for (int i = 0; i < background_set.count; i++) {
+        background_set.bank[i] = assign_bank(&background_banks, background_set.pixels[i], TILE_PIXELS);
+    }
+    for (int i = 0; i < ForestBackground_width * ForestBackground_height; i++) {
+        int bank = background_set.bank[background_map[i] & ENTRY_TILE];
+        background_map[i] |= bank << ENTRY_BANK_SHIFT;
+    }
+
+    build_palette(&background_banks, GBAProjectBackground1_palette, background_palette);
+}
+
+/* lay out copies of the forest across the world, every other one mirrored across
+ * and down so that the edges of neighbouring copies match up - the world is
+ * stored in 32x32 blocks the same way a big background is */
+static void build_world() {
+    for (int y = 0; y < WORLD_HEIGHT; y++) {
+        for (int x = 0; x < WORLD_WIDTH; x++) {
+            int fx = x % ForestBackground_width;
+            int fy = y % ForestBackground_height;
+            int flips = 0;
+            if ((x / ForestBackground_width) & 1) {
+                fx = ForestBackground_width - 1 - fx;
+                flips |= ENTRY_FLIP_H;
+            }
+            if ((y / ForestBackground_height) & 1) {
+                fy = ForestBackground_height - 1 - fy;
+                flips |= ENTRY_FLIP_V;
+            }
+            world_map[map_index(x, y, WORLD_WIDTH, WORLD_HEIGHT)] =
+                background_map[fy * ForestBackground_width + fx] ^ flips;
+        }
+    }
+
+    collision_map_build(world_rows, world_columns, world_map, WORLD_WIDTH, WORLD_HEIGHT);
+}
+
+/* turn the sprites to 4bpp - the tiles of a frame have to stay next to each other
+ * in VRAM, so they are kept in order rather than merged */
+static void convert_sprites() {
+    int count = sizeof(Sprites_data) / TILE_BYTES_8BPP;
+
+    for (int t = 0; t < count; t++) {
+        add_tile(&sprite_set, Sprites_data + t * TILE_BYTES_8BPP);
+    }
+    for (int t = 0; t < count; t += SPRITE_FRAME_TILES) {
+        int tiles = (count - t < SPRITE_FRAME_TILES) ? count - t : SPRITE_FRAME_TILES;
+        int bank = assign_bank(&sprite_banks, Sprites_data + t * TILE_BYTES_8BPP, tiles * TILE_PIXELS);
+        for (int i = t; i < t + tiles; i++) {
+            sprite_set.bank[i] = bank;
+        }
+    }
+
+    build_palette(&sprite_banks, Sprites_palette, sprite_palette);
+}
+
+/* write the header word the BIOS reads, returning its size */
+static int write_header(unsigned char* out, int type, int size) {
+    out[0] = type;
+    out[1] = size & 0xff;
+    out[2] = (size >> 8) & 0xff;
+    out[3] = (size >> 16) & 0xff;
+    return 4;
+}
+
+/* the BIOS reads the blobs a word at a time, so they are padded to a word */
+static int pad(unsigned char* out, int length) {
+    while (length % 4 != 0) {
+        out[length++] = 0;
+    }
+    return length;
+}
+
+/* pack with LZ77, taking the longest match at each point */
+static int compress_lz77(const unsigned char* in, int size, unsigned char* out) {
+    int length = write_header(out, ASSET_LZ77, size);
+    int i = 0;
+
+    while (i < size) {
+        /* each flag byte says which of the next 8 blocks are references */
+        int flags = length++;
+        out[flags] = 0;
+
+        for (int bit = 7; bit >= 0 && i < size; bit--) {
+            int best_length = 0;
+            int best_distance = 0;
+            for (int distance = LZ77_MIN_DISTANCE; distance <= LZ77_MAX_DISTANCE && distance <= i; distance++) {
+                int match = 0;
+                while (match < LZ77_MAX_LENGTH && i + match < size &&
+                        in[i + match - distance] == in[i + match]) {
+                    match++;
+                }
+                if (match > best_length) {
+                    best_length = match;
+                    best_distance = distance;
+                }
+            }
+
+            if (best_length >= LZ77_MIN_LENGTH) {
+                out[flags] |= 1 << bit;
+                out[length++] = ((best_length - 3) << 4) | ((best_distance - 1) >> 8);
+                out[length++] = (best_distance - 1) & 0xff;
+                i += best_length;
+            } else {
+                out[length++] = in[i++];
+            }
+        }
+    }
+    return pad(out, length);
+}
+
+/* pack with RL, which only helps with long runs of one byte */
+static int compress_rl(const unsigned char* in, int size, unsigned char* out) {
+    int length = write_header(out, ASSET_RL, size);
+    int i = 0;
+
+    while (i < size) {
+        int run = 1;
+        while (run < RL_MAX_RUN && i + run < size && in[i + run] == in[i]) {
+            run++;
+        }
+
+        if (run >= RL_MIN_RUN) {
+            out[length++] = 0x80 | (run - RL_MIN_RUN);
+            out[length++] = in[i];
+            i += run;
+            continue;
+        }
+
+        /* copy bytes over as they are up to the start of the next run */
+        int start = i;
+        while (i < size && i - start < RL_MAX_COPY) {
+            if (i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        out[length++] = i - start - 1;
+        memcpy(out + length, in + start, i - start);
+        length += i - start;
+    }
+    return pad(out, length);
+}
+
+/* write one blob, returns 0 if it can't be written */
+static int write_blob(const char* name, const unsigned char* data, int length) {
+    char path[256];
+    snprintf(path, sizeof(path), "assets/%s.bin", name);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "assetconv: can't write %s\n", path);
+        return 0;
+    }
+    fwrite(data, 1, length, file);
+    fclose(file);
+    return 1;
+}
+
+int main() {
+    static unsigned char lz77[MAX_PACKED_SIZE];
+    static unsigned char rl[MAX_PACKED_SIZE];
+
+    convert_background();
+    build_world();
+    convert_sprites();
+
+    struct Asset assets[] = {
+        {"background_palette", "the background's colors in 16 color banks",
+            background_palette, sizeof(background_palette), sizeof(GBAProjectBackground1_palette)},
+        {"background_tiles", "the background's 8x8 tiles, with no two the same when flipped",
+            background_tiles, write_4bpp(&background_set, &background_banks, background_tiles),
+            sizeof(GBAProjectBackground1_data)},
+        {"sprite_palette", "the sprites' colors in 16 color banks",
+            sprite_palette, sizeof(sprite_palette), sizeof(Sprites_palette)}
+    };
+    int num_assets = sizeof(assets) / sizeof(assets[0]);
+    int packed[num_assets];
+    int types[num_assets];
+
+    printf("%-20s %8s %8s %8s %8s %8s   %s\n", "asset", "8bpp", "4bpp", "saved",
+            "lz77", "rl", "ratio");
+    for (int a = 0; a < num_assets; a++) {
+        struct Asset* asset = &assets[a];
+        if (asset->size > MAX_ASSET_SIZE) {
+            fprintf(stderr, "assetconv: %s is too big\n", asset->name);
+            return 1;
+        }
+
+        int lz77_length = compress_lz77(asset->data, asset->size, lz77);
+        int rl_length = compress_rl(asset->data, asset->size, rl);
+
+        /* keep whichever came out smaller */
+        if (lz77_length <= rl_length) {
+            types[a] = ASSET_LZ77;
+            packed[a] = lz77_length;
+            if (!write_blob(asset->name, lz77, lz77_length)) {
+                return 1;
+            }
+        } else {
+            types[a] = ASSET_RL;
+            packed[a] = rl_length;
+            if (!write_blob(asset->name, rl, rl_length)) {
+                return 1;
+            }
+        }
+
+        printf("%-20s %8d %8d %8d %8d %8d   %.2f:1 (%s)\n", asset->name, asset->original_size,
+                asset->size, asset->original_size - asset->size, lz77_length, rl_length,
+                (double) asset->size / packed[a], types[a] == ASSET_LZ77 ? "lz77" : "rl");
+    }
+    printf("background: %d tiles down to %d in %d palette banks\n",
+            (int) (sizeof(GBAProjectBackground1_data) / TILE_BYTES_8BPP), background_set.count,
+            background_banks.count);
+    printf("sprites: %d tiles in %d palette banks\n", sprite_set.count, sprite_banks.count);
+
+    /* the world has to be read a tile at a time and the sprite sheet a frame at
+     * a time, so they are left unpacked */
+    int sprite_sheet_size = write_4bpp(&sprite_set, &sprite_banks, sprite_tiles);
+    if (!write_blob("world_map", (unsigned char*) world_map, sizeof(world_map)) ||
+            !write_blob("world_rows", (unsigned char*) world_rows, sizeof(world_rows)) ||
+            !write_blob("world_columns", (unsigned char*) world_columns, sizeof(world_columns)) ||
+            !write_blob("sprite_sheet", sprite_tiles, sprite_sheet_size)) {
+        return 1;
+    }
+    printf("world: %dx%d tiles, %d bytes of map and %d of collision bits\n", WORLD_WIDTH,
+            WORLD_HEIGHT, (int) sizeof(world_map), (int) (sizeof(world_rows) + sizeof(world_columns)));
+
+    /* the assembly which pulls the blobs into the ROM - it has no instructions,
+     * so the host build can assemble it too */
+    FILE* s = fopen("assets.s", "w");
+    if (!s) {
+        fprintf(stderr, "assetconv: can't write assets.s\n");
+        return 1;
+    }
+    fprintf(s, "/* assets.s\n * generated by assetconv, the compressed graphics */\n\n");
+    fprintf(s, "\t.section .rodata\n");
+    for (int a = 0; a < num_assets; a++) {
+        fprintf(s, "\n\t.global asset_%s\n", assets[a].name);
+        fprintf(s, "\t.balign 4\nasset_%s:\n", assets[a].name);
+        fprintf(s, "\t.incbin \"assets/%s.bin\"\n", assets[a].name);
+    }
+    static const char* raw_blobs[] = {"world_map", "world_rows", "world_columns", "sprite_sheet"};
+    for (int b = 0; b < 4; b++) {
+        fprintf(s, "\n\t.global asset_%s\n", raw_blobs[b]);
+        fprintf(s, "\t.balign 4\nasset_%s:\n", raw_blobs[b]);
+        fprintf(s, "\t.incbin \"assets/%s.bin\"\n", raw_blobs[b]);
+    }
+
+    /* the palette bank of each sprite tile, which is small enough to leave as is */
+    fprintf(s, "\n\t.global asset_sprite_banks\nasset_sprite_banks:");
+    for (int i = 0; i < sprite_set.count; i++) {
+        fprintf(s, "%s%d", (i % 16 == 0) ? "\n\t.byte " : ", ", sprite_set.bank[i]);
+    }
+    fprintf(s, "\n");
+
+    /* nothing here runs off the stack, so the host linker needn't make it executable */
+    fprintf(s, "\n/* no executable stack */\n\t.section .note.GNU-stack,\"\",%%progbits\n");
+    fclose(s);
+
+    /* and the header the game uses to find them */
+    FILE* h = fopen("assets.h", "w");
+    if (!h) {
+        fprintf(stderr, "assetconv: can't write assets.h\n");
+        return 1;
+    }
+    fprintf(h, "/* assets.h\n * generated by assetconv, the compressed graphics in assets.s */\n\n");
+    fprintf(h, "#pragma once\n#ifndef ASSETS_H\n#define ASSETS_H\n\n");
+    for (int a = 0; a < num_assets; a++) {
+        fprintf(h, "\n/* %s, %d bytes packed into %d with %s */\n", assets[a].comment,
+                assets[a].size, packed[a], types[a] == ASSET_LZ77 ? "lz77" : "rl");
+        fprintf(h, "extern const unsigned int asset_%s[];\n", assets[a].name);
+        fprintf(h, "#define asset_%s_packed %d\n", assets[a].name, packed[a]);
+    }
+    fprintf(h, "\n/* the world map in 32x32 blocks, left unpacked so any tile can be read */\n");
+    fprintf(h, "#define asset_world_width %d\n", WORLD_WIDTH);
+    fprintf(h, "#define asset_world_height %d\n", WORLD_HEIGHT);
+    fprintf(h, "extern const unsigned short asset_world_map[];\n");
+    fprintf(h, "\n/* which world tiles are solid, packed by row and by column */\n");
+    fprintf(h, "extern const unsigned int asset_world_rows[];\n");
+    fprintf(h, "extern const unsigned int asset_world_columns[];\n");
+    fprintf(h, "\n/* the %d 4bpp sprite tiles, left unpacked so each sprite's frame can be\n"
+            " * copied into VRAM as it changes */\n", sprite_set.count);
+    fprintf(h, "extern const unsigned int asset_sprite_sheet[];\n");
+    fprintf(h, "\n/* the palette bank each of the %d sprite tiles uses */\n", sprite_set.count);
+    fprintf(h, "extern const unsigned char asset_sprite_banks[];\n");
+    fprintf(h, "\n#endif\n");
+    fclose(h);
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+/* assets.h
+ * generated by assetconv, the compressed graphics in assets.s */
+
+#pragma once
+#ifndef ASSETS_H
+#define ASSETS_H
+
+
+/* the background's colors in 16 color banks, 512 bytes packed into 32 with rl */
+extern const unsigned int asset_background_palette[];
+#define asset_background_palette_packed 32
+
+/* the background's 8x8 tiles, with no two the same when flipped, 256 bytes packed into 140 with lz77 */
+extern const unsigned int asset_background_tiles[];
+#define asset_background_tiles_packed 140
+
+/* the sprites' colors in 16 color banks, 512 bytes packed into 32 with rl */
+extern const unsigned int asset_sprite_palette[];
+#define asset_sprite_palette_packed 32
+
+/* the world map in 32x32 blocks, left unpacked so any tile can be read */
+#define asset_world_width 256
+#define asset_world_height 256
+extern const unsigned short asset_world_map[];
+
+/* which world tiles are solid, packed by row and by column */
+extern const unsigned int asset_world_rows[];
+extern const unsigned int asset_world_columns[];
+
+/* the 46 4bpp sprite tiles, left unpacked so each sprite's frame can be
+ * copied into VRAM as it changes */
+extern const unsigned int asset_sprite_sheet[];
+
+/* the palette bank each of the 46 sprite tiles uses */
+extern const unsigned char asset_sprite_banks[];
+
+#endif
@@ -0,0 +1,48 @@
+/* assets.s
+ * generated by assetconv, the compressed graphics */
+
+	.section .rodata
+
+	.global asset_background_palette
+	.balign 4
+asset_background_palette:
+	.incbin "assets/background_palette.bin"
+
+	.global asset_background_tiles
+	.balign 4
+asset_background_tiles:
+	.incbin "assets/background_tiles.bin"
+
+	.global asset_sprite_palette
+	.balign 4
+asset_sprite_palette:
+	.incbin "assets/sprite_palette.bin"
+
+	.global asset_world_map
+	.balign 4
+asset_world_map:
+	.incbin "assets/world_map.bin"
+
+	.global asset_world_rows
+	.balign 4
+asset_world_rows:
+	.incbin "assets/world_rows.bin"
+
+	.global asset_world_columns
+	.balign 4
+asset_world_columns:
+	.incbin "assets/world_columns.bin"
+
+	.global asset_sprite_sheet
+	.balign 4
+asset_sprite_sheet:
+	.incbin "assets/sprite_sheet.bin"
+
+	.global asset_sprite_banks
+asset_sprite_banks:
+	.byte 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	.byte 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	.byte 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+
+/* no executable stack */
+	.section .note.GNU-stack,"",%progbits
@@ -0,0 +1,363 @@
+/*
+ * batch.c
+ * host batch runner which plays many games at once, with no display, to see how
+ * long players last and how far they get
+ *
+ * build with:
+ *   gcc -DHOST -O2 -fno-strict-aliasing -pthread -o batch batch.c game.c anim.c asset.c dma.c flow.c grid.c input.c map.c physics.c raster.c spawn.c stream.c timer.c host.c assets.s
+ * and run as:
+ *   ./batch [games] [frames] [policy] [threads] [csv]
+ * which plays each game until the player dies or it reaches the frame limit -
+ * the policy is random, sweep or still, threads defaults to one per core, and
+ * each game's results are written to the csv file if one is given
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gba.h"
+#include "game.h"
+
+/* the buttons as game_step takes them, a 1 means held */
+#define BATCH_A (1 << 0)
+#define BATCH_RIGHT (1 << 4)
+#define BATCH_LEFT (1 << 5)
+#define BATCH_UP (1 << 6)
+#define BATCH_DOWN (1 << 7)
+
+/* waves past the last one are counted with it */
+#define BATCH_WAVES 32
+
+/* the most threads to start */
+#define BATCH_MAX_THREADS 256
+
+/* how the keys are picked for each frame */
+enum BatchPolicy {
+    /* walk a random way for a while then pick another, firing most of the
+     * time, like the benchmark's scripted player */
+    BATCH_RANDOM,
+
+    /* walk right, down, left and up in turn, always firing */
+    BATCH_SWEEP,
+
+    /* stand still and fire */
+    BATCH_STILL
+};
+
+static const char* batch_policy_names[] = {"random", "sweep", "still"};
+
+/* how one game went */
+struct BatchResult {
+    /* the frames played, and whether they ended with the player dying */
+    unsigned long frames;
+    int died;
+
+    int kills;
+    int wave;
+
+    /* the frame each wave was first reached on, or -1 */
+    long wave_frame[BATCH_WAVES];
+
+    /* the nanoseconds game_step took in total, and on the slowest frame */
+    unsigned long long ns;
+    unsigned long long ns_max;
+};
+
+/* the games to play, shared between the threads - each thread takes the next
+ * game until there are none left */
+struct BatchWork {
+    int games;
+    unsigned long frames;
+    enum BatchPolicy policy;
+    struct BatchResult* results;
+    int next;
+
+    /* set by a thread which couldn't get the memory for its game */
+    int failed;
+};
+
+/* the same small random number generator as the benchmark */
+static unsigned int batch_random(unsigned int* state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* the keys to hold for a frame */
+static unsigned short batch_input(enum BatchPolicy policy, unsigned int* state,
+        unsigned long frame, unsigned short held) {
+    static const unsigned short directions[5] = {
+        0, BATCH_RIGHT, BATCH_LEFT, BATCH_UP, BATCH_DOWN
+    };
+    static const unsigned short sweep[4] = {
+        BATCH_RIGHT, BATCH_DOWN, BATCH_LEFT, BATCH_UP
+    };
+
+    switch (policy) {
+        case BATCH_RANDOM:
+            if (frame % 32 == 0) {
+                held = directions[batch_random(state) % 5];
+                if (batch_random(state) % 4 != 0) {
+                    held |= BATCH_A;
+                }
+            }
+            return held;
+        case BATCH_SWEEP:
+            return sweep[(frame / 64) % 4] | BATCH_A;
+        default:
+            return BATCH_A;
+    }
+}
+
+/* play one game to the end - each game gets its own random numbers, so the
+ * results don't depend on which thread plays it */
+static void batch_play(struct Game* game, int index, const struct BatchWork* work,
+        struct BatchResult* result) {
+    unsigned int state = 0x2545f491 ^ ((unsigned int) index * 0x9e3779b9u);
+    if (state == 0) {
+        state = 1;
+    }
+    unsigned short held = 0;
+
+    game_init_headless(game);
+
+    result->died = 0;
+    result->ns = 0;
+    result->ns_max = 0;
+    for (int w = 0; w < BATCH_WAVES; w++) {
+        result->wave_frame[w] = -1;
+    }
+    result->wave_frame[0] = 0;
+
+    unsigned long frame;
+    for (frame = 0; frame < work->frames; frame++) {
+        int health = game->player.health;
+        int kills = game->kills;
+        int wave = game->wave;
+
+        held = batch_input(work->policy, &state, frame, held);
+        unsigned long long start = host_clock();
+        game_step(game, held);
+        unsigned long long ns = host_clock() - start;
+
+        /* nothing draws the game, so nothing copies what it queued */
+        dma_queue_drop(&game->dma);
+
+        result->ns += ns;
+        if (ns > result->ns_max) {
+            result->ns_max = ns;
+        }
+
+        /* health only goes up when a new game starts, which is when the
+         * player dies - the counts from before it are the ones that count */
+        if (game->player.health > health) {
+            result->died = 1;
+            result->kills = kills;
+            result->wave = wave;
+            frame++;
+            break;
+        }
+
+        int w = game->wave < BATCH_WAVES ? game->wave : BATCH_WAVES - 1;
+        if (result->wave_frame[w] < 0) {
+            result->wave_frame[w] = frame + 1;
+        }
+    }
+
+    result->frames = frame;
+    if (!result->died) {
+        result->kills = game->kills;
+        result->wave = game->wave;
+    }
+}
+
+static void* batch_worker(void* arg) {
+    struct BatchWork* work = (struct BatchWork*) arg;
+
+    /* a whole game is too big to want on a thread's stack */
+    struct Game* game = (struct Game*) malloc(sizeof(struct Game));
+    if (!game) {
+        __atomic_store_n(&work->failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    while (1) {
+        int index = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED);
+        if (index >= work->games) {
+            break;
+        }
+        batch_play(game, index, work, &work->results[index]);
+    }
+
+    free(game);
+    return NULL;
+}
+
+static int batch_compare_frames(const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*) a;
+    unsigned long y = *(const unsigned long*) b;
+    return (x > y) - (x < y);
+}
+
+/* print what the games add up to, returns 0 if there isn't the memory to */
+static int batch_report(const struct BatchWork* work, unsigned long long wall_ns,
+        int threads) {
+    int games = work->games;
+    unsigned long* frames = (unsigned long*) malloc(games * sizeof(unsigned long));
+    if (!frames) {
+        printf("not enough memory to sort %d games\n", games);
+        return 0;
+    }
+    unsigned long long total_frames = 0, ns = 0, ns_max = 0;
+    unsigned long long total_kills = 0, total_waves = 0;
+    int deaths = 0, most_kills = 0, most_wave = 0;
+    int reached[BATCH_WAVES] = {0};
+    double reached_frames[BATCH_WAVES] = {0};
+
+    for (int i = 0; i < games; i++) {
+        const struct BatchResult* result = &work->results[i];
+        frames[i] = result->frames;
+        total_frames += result->frames;
+        ns += result->ns;
+        if (result->ns_max > ns_max) {
+            ns_max = result->ns_max;
+        }
+        deaths += result->died;
+        total_kills += result->kills;
+        total_waves += result->wave;
+        if (result->kills > most_kills) {
+            most_kills = result->kills;
+        }
+        if (result->wave > most_wave) {
+            most_wave = result->wave;
+        }
+        for (int w = 0; w < BATCH_WAVES; w++) {
+            if (result->wave_frame[w] >= 0) {
+                reached[w]++;
+                reached_frames[w] += result->wave_frame[w];
+            }
+        }
+    }
+    qsort(frames, games, sizeof(unsigned long), batch_compare_frames);
+
+    printf("%d games of up to %lu frames, %s policy, on %d threads in %.3f s\n", games,
+            work->frames, batch_policy_names[work->policy], threads, wall_ns / 1e9);
+    printf("%.0f frames/sec over all threads, %.1f ns/frame, %.1f us on the slowest frame\n",
+            total_frames / (wall_ns / 1e9), (double) ns / total_frames, ns_max / 1e3);
+    printf("%d died (%.1f%%), %d reached the frame limit\n", deaths,
+            100.0 * deaths / games, games - deaths);
+    printf("survived frames: min %lu, median %lu, 90th percentile %lu, max %lu, mean %.1f\n",
+            frames[0], frames[games / 2], frames[games * 9 / 10], frames[games - 1],
+            (double) total_frames / games);
+    printf("kills: mean %.2f, max %d    wave: mean %.2f, max %d\n",
+            (double) total_kills / games, most_kills, (double) total_waves / games, most_wave);
+
+    printf("%-6s %8s %8s %14s\n", "wave", "games", "share", "mean frame");
+    for (int w = 0; w < BATCH_WAVES; w++) {
+        if (reached[w]) {
+            printf("%-6d %8d %7.1f%% %14.1f\n", w, reached[w], 100.0 * reached[w] / games,
+                    reached_frames[w] / reached[w]);
+        }
+    }
+    free(frames);
+    return 1;
+}
+
+/* write a line for each game */
+static int batch_csv(const struct BatchWork* work, const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        printf("can't write %s\n", path);
+        return 0;
+    }
+
+    fprintf(out, "game,frames,died,kills,wave,ns_per_frame,ns_max\n");
+    for (int i = 0; i < work->games; i++) {
+        const struct BatchResult* result = &work->results[i];
+        fprintf(out, "%d,%lu,%d,%d,%d,%.1f,%llu\n", i, result->frames, result->died,
+                result->kills, result->wave,
+                result->frames ? (double) result->ns / result->frames : 0.0, result->ns_max);
+    }
+    fclose(out);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    struct BatchWork work;
+    work.games = argc > 1 ? atoi(argv[1]) : 1000;
+    work.frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 36000;
+    work.policy = BATCH_RANDOM;
+    work.next = 0;
+    work.failed = 0;
+
+    if (argc > 3) {
+        int found = 0;
+        for (int p = 0; p <= BATCH_STILL; p++) {
+            if (strcmp(argv[3], batch_policy_names[p]) == 0) {
+                work.policy = (enum BatchPolicy) p;
+                found = 1;
+            }
+        }
+        if (!found) {
+            printf("unknown policy %s, pick random, sweep or still\n", argv[3]);
+            return 1;
+        }
+    }
+
+    int threads = argc > 4 ? atoi(argv[4]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > BATCH_MAX_THREADS) {
+        threads = BATCH_MAX_THREADS;
+    }
+    if (work.games < 1) {
+        printf("there have to be some games to play\n");
+        return 1;
+    }
+
+    work.results = (struct BatchResult*) calloc(work.games, sizeof(struct BatchResult));
+    if (!work.results) {
+        printf("not enough memory for %d games\n", work.games);
+        return 1;
+    }
+
+    /* the section timers are shared, so keep them off */
+    host_bench_enabled = 0;
+
+    pthread_t workers[BATCH_MAX_THREADS];
+    unsigned long long start = host_clock();
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&workers[t], NULL, batch_worker, &work) != 0) {
+            printf("can't start thread %d\n", t);
+            return 1;
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    unsigned long long wall_ns = host_clock() - start;
+
+    /* the results of a batch which didn't run on every thread aren't what
+     * was asked for, and with none running there wouldn't be any */
+    if (work.failed) {
+        printf("not enough memory for a game on every thread\n");
+        return 1;
+    }
+
+    if (!batch_report(&work, wall_ns, threads)) {
+        return 1;
+    }
+    if (argc > 5 && !batch_csv(&work, argv[5])) {
+        return 1;
+    }
+
+    free(work.results);
+    return 0;
+}
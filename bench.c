@@ -0,0 +1,828 @@
+/*
+ * bench.c
+ * host benchmark which steps the game logic for many frames
+ *
+ * build with:
+ *   gcc -DHOST -O2 -fno-strict-aliasing -o bench bench.c game.c anim.c asset.c dma.c flow.c grid.c input.c map.c physics.c raster.c spawn.c stream.c timer.c host.c render.c assets.s
+ * and run as:
+ *   ./bench [frames]          time the whole game
+ *   ./bench broadphase        compare the collision grid against testing every pair
+ *   ./bench sort              compare packing sprites into OAM front to back
+ *                             against packing them in the order they were made
+ *   ./bench mux               draw more sprites than OAM holds by multiplexing
+ *                             them, checking the frames against drawing them
+ *                             a batch at a time
+ *   ./bench raster [frames]   play the scripted run with a wave on the scroll and
+ *                             a gradient on a color, checking frames against
+ *                             setting the registers by hand for each line
+ *   ./bench assets            time unpacking each asset against copying it raw
+ *   ./bench replay [frames]   record the scripted run, play it back, and check
+ *                             the game ends up exactly the same
+ *   ./bench render [frames] [hashes] [png prefix]
+ *                             draw every frame of the scripted run, checking
+ *                             them against a file of hashes (or writing it if
+ *                             it isn't there), and saving the frames which
+ *                             differ as PNGs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gba.h"
+#include "game.h"
+#include "grid.h"
+#include "map.h"
+#include "asset.h"
+#include "assets.h"
+#include "render.h"
+
+/* the buttons as the host sets them, a 1 means held */
+#define BENCH_A (1 << 0)
+#define BENCH_RIGHT (1 << 4)
+#define BENCH_LEFT (1 << 5)
+#define BENCH_UP (1 << 6)
+#define BENCH_DOWN (1 << 7)
+
+/* the names printed for each timed section */
+static const char* bench_names[NUM_BENCH_SECTIONS] = {
+    "player_update",
+    "slime_move",
+    "bullet_check",
+    "collision_check",
+    "calc_wave",
+    "sprite_update_all",
+    "stream_draw",
+    "dma_flush"
+};
+
+/* a small random number generator, so every run sees the same input */
+static unsigned int bench_random(unsigned int* state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* the scripted player: walk in one direction for a while then pick another,
+ * and hold down fire most of the time */
+static unsigned short bench_input(unsigned int* state, unsigned long frame,
+        unsigned short held) {
+    static const unsigned short directions[5] = {
+        0, BENCH_RIGHT, BENCH_LEFT, BENCH_UP, BENCH_DOWN
+    };
+
+    if (frame % 32 == 0) {
+        held = directions[bench_random(state) % 5];
+        if (bench_random(state) % 4 != 0) {
+            held |= BENCH_A;
+        }
+    }
+    return held;
+}
+
+/* the game being timed, kept around so its counters can be read afterwards */
+static struct Game game;
+
+/* what to do with the input log as the game starts */
+#define BENCH_LIVE 0
+#define BENCH_RECORD 1
+#define BENCH_REPLAY 2
+
+/* run the game for a number of frames, returning the nanoseconds it took -
+ * while replaying, the scripted keys are still set but the game should not
+ * see them - after is called once each frame has been drawn, if it is set */
+static unsigned long long bench_run_log(unsigned long frames, int log,
+        void (*after)(unsigned long frame)) {
+    unsigned int state = 0x2545f491;
+    unsigned short held = 0;
+
+    host_reset();
+    game_init(&game);
+    if (log == BENCH_RECORD) {
+        input_record(&game.input_log);
+    } else if (log == BENCH_REPLAY && !input_replay(&game.input_log)) {
+        printf("no input log to replay\n");
+        exit(1);
+    }
+
+    unsigned long long start = host_clock();
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        held = bench_input(&state, frame, held);
+        host_set_buttons(log == BENCH_REPLAY ? ~held & 0xff : held);
+        game_update(&game);
+        game_draw(&game);
+        if (after) {
+            after(frame);
+        }
+    }
+    return host_clock() - start;
+}
+
+static unsigned long long bench_run(unsigned long frames) {
+    return bench_run_log(frames, BENCH_LIVE, NULL);
+}
+
+/* record the scripted run into SRAM, play it back with other keys held, and
+ * check the game and the video memory come out the same both times */
+static int bench_replay(unsigned long frames) {
+    static struct Game recorded;
+    static unsigned short vram[HOST_VRAM_SIZE], oam[HOST_OAM_SIZE];
+
+    unsigned long long record_ns = bench_run_log(frames, BENCH_RECORD, NULL);
+    recorded = game;
+    memcpy(vram, host_vram, sizeof(vram));
+    memcpy(oam, host_oam, sizeof(oam));
+    int length = game.input_log.length;
+    int full = game.input_log.full;
+
+    unsigned long long replay_ns = bench_run_log(frames, BENCH_REPLAY, NULL);
+
+    /* the log itself was recording one time and playing back the other */
+    recorded.input_log = game.input_log;
+    int same = memcmp(&recorded, &game, sizeof(game)) == 0 &&
+        memcmp(vram, host_vram, sizeof(vram)) == 0 && memcmp(oam, host_oam, sizeof(oam)) == 0;
+
+    printf("%lu frames logged in %d bytes (%d runs, %.1f frames a run)%s\n", frames,
+            INPUT_LOG_HEADER + length, length / INPUT_LOG_RUN,
+            (double) frames / (length / INPUT_LOG_RUN), full ? ", the log filled up" : "");
+    printf("recorded in %.1f ns/frame, replayed in %.1f ns/frame\n",
+            (double) record_ns / frames, (double) replay_ns / frames);
+    printf("replay %s: %d kills, wave %d\n", same ? "matches" : "DIFFERS",
+            game.kills, game.wave);
+    return same ? 0 : 1;
+}
+
+/* does a bullet's middle land inside a 16x16 slime, the same test bullet_check
+ * does */
+static int bench_hit(int bx, int by, int sx, int sy) {
+    return bx > sx && bx < sx + 16 && by > sy && by < sy + 16;
+}
+
+/* test every bullet against every slime - the GBA has no vector unit, so keep
+ * the compiler from doing several pairs at once here either */
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static unsigned long bench_pairs(const int* bx, const int* by, const int* sx,
+        const int* sy, int count) {
+    unsigned long hits = 0;
+    for (int b = 0; b < count; b++) {
+        for (int i = 0; i < count; i++) {
+            hits += bench_hit(bx[b] + 4, by[b] + 4, sx[i], sy[i]);
+        }
+    }
+    return hits;
+}
+
+/* move every entity a step in a random direction, staying on screen */
+static void bench_wander(int* x, int* y, int count, unsigned int* state) {
+    for (int i = 0; i < count; i++) {
+        unsigned int r = bench_random(state);
+        x[i] += (int) (r % 3) - 1;
+        y[i] += (int) ((r >> 16) % 3) - 1;
+        if (x[i] < 0) x[i] = 0;
+        if (x[i] > 224) x[i] = 224;
+        if (y[i] < 0) y[i] = 0;
+        if (y[i] > 144) y[i] = 144;
+    }
+}
+
+/* time bullet against slime checks for growing numbers of each, with every
+ * pair tested and with the grid picking the candidates */
+static void bench_broadphase() {
+    static int sx[GRID_MAX_ITEMS], sy[GRID_MAX_ITEMS];
+    static int bx[GRID_MAX_ITEMS], by[GRID_MAX_ITEMS];
+    static unsigned char ids[GRID_MAX_ITEMS];
+    static struct Grid grid;
+
+    printf("%-10s %14s %14s %12s %12s\n", "of each", "pairs ns/frame",
+            "grid ns/frame", "pair tests", "grid tests");
+    for (int count = 8; count <= GRID_MAX_ITEMS; count *= 2) {
+        /* count bullets and count slimes spread over the screen */
+        unsigned int state = 0x9e3779b9;
+        for (int i = 0; i < count; i++) {
+            sx[i] = bench_random(&state) % 225;
+            sy[i] = bench_random(&state) % 145;
+            bx[i] = bench_random(&state) % 225;
+            by[i] = bench_random(&state) % 145;
+            ids[i] = i;
+        }
+
+        /* keep the work per size about the same */
+        int frames = 4000000 / (count * count) + 1000;
+        unsigned long long pair_ns = 0, grid_ns = 0;
+        unsigned long pair_hits = 0, grid_hits = 0, grid_tests = 0;
+
+        for (int frame = 0; frame < frames; frame++) {
+            bench_wander(sx, sy, count, &state);
+            bench_wander(bx, by, count, &state);
+
+            /* every bullet against every slime */
+            unsigned long long start = host_clock();
+            pair_hits += bench_pairs(bx, by, sx, sy, count);
+            unsigned long long middle = host_clock();
+
+            /* rebuild the grid, then only test what it hands back */
+            unsigned char nearby[GRID_MAX_ITEMS];
+            grid_build(&grid, sx, sy, 0, 0, 0, ids, count);
+            for (int b = 0; b < count; b++) {
+                int found = grid_query(&grid, bx[b] + 4, by[b] + 4, 1, 1, nearby, GRID_MAX_ITEMS);
+                grid_tests += found;
+                for (int n = 0; n < found; n++) {
+                    grid_hits += bench_hit(bx[b] + 4, by[b] + 4, sx[nearby[n]], sy[nearby[n]]);
+                }
+            }
+            unsigned long long end = host_clock();
+
+            pair_ns += middle - start;
+            grid_ns += end - middle;
+        }
+
+        printf("%-10d %14.1f %14.1f %12d %12.1f%s\n", count,
+                (double) pair_ns / frames, (double) grid_ns / frames,
+                count * count, (double) grid_tests / frames,
+                pair_hits == grid_hits ? "" : "  (hit counts differ!)");
+    }
+}
+
+/* is any part of a w by h pixel box at (x, y) in the world over a solid tile,
+ * looking up each tile under it the way movement did before the bitmaps */
+__attribute__((noinline))
+static int bench_blocked_tiles(int x, int y, int w, int h) {
+    for (int ty = y >> 3; ty <= (y + h - 1) >> 3; ty++) {
+        for (int tx = x >> 3; tx <= (x + w - 1) >> 3; tx++) {
+            unsigned short entry = asset_world_map[map_index(tx, ty, asset_world_width,
+                    asset_world_height)];
+            if (tile_properties[entry & 0x3ff] & TILE_SOLID) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* the boxes movement tests - the left or right edge of a 16x16 sprite, its top
+ * or bottom edge, and the whole sprite */
+static const int bench_boxes[][2] = {{1, 15}, {15, 1}, {16, 16}};
+
+#define NUM_BENCH_BOXES ((int) (sizeof(bench_boxes) / sizeof(bench_boxes[0])))
+
+/* check map_blocked against looking up each tile, for every box at every pixel
+ * of the world and a sprite's width past each end so the wrap is covered too,
+ * and time both */
+static int bench_collision() {
+    const struct CollisionMap map = {
+        asset_world_width, asset_world_height, asset_world_rows, asset_world_columns
+    };
+    int first = -16;
+    int last = asset_world_width * 8 + 16;
+    unsigned long mismatches = 0;
+
+    printf("%-8s %12s %12s %12s %12s\n", "box", "tests", "blocked", "bitmap ns", "tiles ns");
+    for (int b = 0; b < NUM_BENCH_BOXES; b++) {
+        int w = bench_boxes[b][0];
+        int h = bench_boxes[b][1];
+        unsigned long tests = 0, blocked = 0;
+        unsigned long long bitmap_ns = 0, tiles_ns = 0;
+
+        /* a row at a time, so the timer is read rarely */
+        for (int y = first; y < last; y++) {
+            static unsigned char from_bitmap[2 * 8 * asset_world_width];
+            unsigned long long start = host_clock();
+            for (int x = first; x < last; x++) {
+                from_bitmap[x - first] = map_blocked(&map, x, y, w, h);
+            }
+            unsigned long long middle = host_clock();
+            for (int x = first; x < last; x++) {
+                int expected = bench_blocked_tiles(x, y, w, h);
+                mismatches += from_bitmap[x - first] != expected;
+                blocked += expected;
+            }
+            unsigned long long end = host_clock();
+
+            tests += last - first;
+            bitmap_ns += middle - start;
+            tiles_ns += end - middle;
+        }
+
+        printf("%2dx%-5d %12lu %12lu %12.2f %12.2f\n", w, h, tests, blocked,
+                (double) bitmap_ns / tests, (double) tiles_ns / tests);
+    }
+    printf("%lu boxes where map_blocked and the tiles disagree\n", mismatches);
+    return mismatches != 0;
+}
+
+/* the number of pairs of neighbouring entries of OAM which are out of order,
+ * with the lower one's feet further up the screen */
+static int bench_misordered(const struct SpriteTable* table) {
+    int wrong = 0;
+    for (int entry = 1; entry < table->shown; entry++) {
+        if ((table->oam[entry].attribute0 & 0xff) > (table->oam[entry - 1].attribute0 & 0xff)) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+/* time packing growing numbers of 16x16 sprites wandering around the screen
+ * into OAM, sorted front to back and in the order they were made */
+static void bench_sort() {
+    static struct SpriteTable table;
+    static int x[NUM_SPRITES], y[NUM_SPRITES];
+
+    printf("%-10s %16s %16s %14s\n", "sprites", "unsorted ns/frame",
+            "sorted ns/frame", "misordered");
+    for (int count = 16; count <= OAM_ENTRIES; count *= 2) {
+        unsigned int state = 0x9e3779b9;
+        for (int i = 0; i < count; i++) {
+            x[i] = bench_random(&state) % 225;
+            y[i] = bench_random(&state) % 145;
+        }
+
+        int frames = 200000;
+        unsigned long long ns[2] = {0, 0};
+        int misordered = 0;
+
+        for (int sorted = 0; sorted < 2; sorted++) {
+            sprite_clear(&table);
+            table.depth_sort = sorted;
+            table.next = count;
+
+            for (int frame = 0; frame < frames; frame++) {
+                /* every sprite moves, so every one has to be looked at again */
+                bench_wander(x, y, count, &state);
+                for (int i = 0; i < count; i++) {
+                    table.sprites[i].attribute0 = y[i];
+                    table.sprites[i].attribute1 = x[i] | (1 << 14);
+                }
+                for (int word = 0; word < NUM_SPRITES / 32; word++) {
+                    table.dirty[word] = 0xffffffff;
+                }
+
+                unsigned long long start = host_clock();
+                sprite_pack(&table);
+                ns[sorted] += host_clock() - start;
+            }
+            if (sorted) {
+                misordered = bench_misordered(&table);
+            }
+        }
+
+        printf("%-10d %16.1f %16.1f %14d\n", count, (double) ns[0] / frames,
+                (double) ns[1] / frames, misordered);
+    }
+}
+
+/* lay out count 8x8 sprites in rows of 20, spacing pixels apart with the first
+ * row at line top, showing the ones from first up to last which are on the
+ * screen - each has its own palette bank, so one in the wrong place shows */
+static void bench_mux_layout(struct SpriteTable* table, int count, int spacing, int top,
+        int first, int last) {
+    table->next = count;
+    for (int i = 0; i < count; i++) {
+        int y = top + (i / 20) * spacing;
+        int shown = i >= first && i < last && y > -8 && y < RENDER_HEIGHT;
+        table->sprites[i].attribute0 = (y & 0xff) | (shown ? 0 : 0x200);
+        table->sprites[i].attribute1 = (i % 20) * 12;
+        table->sprites[i].attribute2 = (i % 16) << 12;
+    }
+    for (int word = 0; word < NUM_SPRITES / 32 + 1; word++) {
+        table->dirty[word] = 0xffffffff;
+    }
+}
+
+/* pack a table's sprites and draw them, with all of its copy of OAM put in
+ * place as vblank would - the two tables share OAM, so only copying what
+ * changed wouldn't do - returns the nanoseconds the packing took */
+static unsigned long long bench_mux_frame(struct SpriteTable* table, struct DmaQueue* queue,
+        unsigned short* pixels) {
+    unsigned long long start = host_clock();
+    sprite_update_all(table, queue);
+    unsigned long long ns = host_clock() - start;
+
+    dma_queue_drop(queue);
+    sprite_mux_show(table);
+    memcpy(host_oam, table->oam, sizeof(table->oam));
+    render_frame(pixels);
+    return ns;
+}
+
+/* draw growing numbers of sprites moving down the screen across the bands,
+ * multiplexed, and check each frame against drawing them 128 at a time -
+ * then pile them all into the top two bands to see the extra ones dropped */
+static void bench_mux() {
+    static struct SpriteTable table, single;
+    static struct DmaQueue queue;
+    static unsigned short pixels[RENDER_WIDTH * RENDER_HEIGHT];
+    static unsigned short expected[RENDER_WIDTH * RENDER_HEIGHT];
+
+    /* sprites on, with one solid tile and a color for each palette bank */
+    host_reset();
+    host_io[0] = 0x1000 | 0x40;
+    memset((char*) host_vram + 0x10000, 0x11, 32);
+    for (int bank = 0; bank < 16; bank++) {
+        host_palette[0x100 + bank * 16 + 1] = 0x1f + bank * 0x7c0;
+    }
+    dma_queue_init(&queue, DMA_BUDGET);
+
+    printf("%-8s %8s %10s %10s %12s %10s %12s\n", "sprites", "frames", "mux frames",
+            "dropped", "pack ns", "band max", "bad pixels");
+    for (int count = OAM_ENTRIES; count <= NUM_SPRITES; count += 64) {
+        sprite_clear(&table);
+        sprite_clear(&single);
+        memset(table.band_max, 0, sizeof(table.band_max));
+        memset(table.band_dropped, 0, sizeof(table.band_dropped));
+        table.mux_frames = 0;
+
+        int frames = 48;
+        unsigned long long ns = 0;
+        unsigned long bad = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            int top = frame;
+
+            /* what it should look like, drawn a batch at a time - none of the
+             * sprites overlap, so each batch's pixels can just be put together */
+            bench_mux_layout(&single, count, 12, top, 0, 0);
+            bench_mux_frame(&single, &queue, expected);
+            unsigned short backdrop = expected[0];
+            for (int first = 0; first < count; first += OAM_ENTRIES) {
+                bench_mux_layout(&single, count, 12, top, first, first + OAM_ENTRIES);
+                bench_mux_frame(&single, &queue, pixels);
+                for (int p = 0; p < RENDER_WIDTH * RENDER_HEIGHT; p++) {
+                    if (pixels[p] != backdrop) {
+                        expected[p] = pixels[p];
+                    }
+                }
+            }
+
+            bench_mux_layout(&table, count, 12, top, 0, count);
+            ns += bench_mux_frame(&table, &queue, pixels);
+            for (int p = 0; p < RENDER_WIDTH * RENDER_HEIGHT; p++) {
+                bad += pixels[p] != expected[p];
+            }
+        }
+
+        unsigned long dropped = 0;
+        int most = 0;
+        for (int band = 0; band < SPRITE_BANDS; band++) {
+            dropped += table.band_dropped[band];
+            if (table.band_max[band] > most) {
+                most = table.band_max[band];
+            }
+        }
+        printf("%-8d %8d %10lu %10lu %12.1f %10d %12lu\n", count, frames, table.mux_frames,
+                dropped, (double) ns / frames, most, bad);
+    }
+
+    /* far too many in too few lines - the ones which don't fit their band's
+     * half of OAM are left out, furthest back first */
+    sprite_clear(&table);
+    memset(table.band_dropped, 0, sizeof(table.band_dropped));
+    bench_mux_layout(&table, NUM_SPRITES, 4, 0, 0, NUM_SPRITES);
+    bench_mux_frame(&table, &queue, pixels);
+    printf("\n%d sprites in lines 0 to %d, by band:\n", NUM_SPRITES, (NUM_SPRITES / 20) * 4 + 7);
+    printf("%-6s %8s %8s\n", "band", "sprites", "dropped");
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        printf("%-6d %8d %8lu\n", band, table.band_last[band], table.band_dropped[band]);
+    }
+
+    /* and with every tenth one 16x32, too tall to be multiplexed */
+    sprite_clear(&table);
+    table.too_tall = 0;
+    bench_mux_layout(&table, 192, 12, 0, 0, 192);
+    int tall = 0;
+    for (int i = 0; i < 192; i += 10) {
+        table.sprites[i].attribute0 |= 0x8000;
+        table.sprites[i].attribute1 |= 0x8000;
+        tall++;
+    }
+    bench_mux_frame(&table, &queue, pixels);
+    printf("\n192 sprites, %d of them 16x32: %lu left out for being taller than %d lines\n",
+            tall, table.too_tall, SPRITE_MUX_HEIGHT);
+}
+
+/* the assets as they are in the ROM */
+struct BenchAsset {
+    const char* name;
+    const unsigned int* data;
+    unsigned int packed;
+};
+
+static const struct BenchAsset bench_assets[] = {
+    {"background_palette", asset_background_palette, asset_background_palette_packed},
+    {"background_tiles", asset_background_tiles, asset_background_tiles_packed},
+    {"sprite_palette", asset_sprite_palette, asset_sprite_palette_packed}
+};
+
+#define NUM_BENCH_ASSETS ((int) (sizeof(bench_assets) / sizeof(bench_assets[0])))
+
+/* time unpacking each asset into VRAM, next to a DMA of the same unpacked size
+ * which is what loading it used to take */
+static void bench_asset_loads() {
+    const int loads = 100000;
+    unsigned short* dest = (unsigned short*) VRAM_ADDRESS(0);
+    static unsigned short raw[HOST_VRAM_SIZE];
+
+    printf("%-20s %8s %8s %8s %12s %12s\n", "asset", "size", "packed", "ratio",
+            "unpack ns", "copy ns");
+    for (int a = 0; a < NUM_BENCH_ASSETS; a++) {
+        const struct BenchAsset* asset = &bench_assets[a];
+        unsigned int size = ASSET_SIZE(asset->data);
+
+        unsigned long long start = host_clock();
+        for (int i = 0; i < loads; i++) {
+            asset_load(dest, asset->data);
+        }
+        unsigned long long middle = host_clock();
+        for (int i = 0; i < loads; i++) {
+            host_dma(dest, raw, (size / 2) | 0x80000000);
+        }
+        unsigned long long end = host_clock();
+
+        printf("%-20s %8u %8u %7.2f:1 %12.1f %12.1f\n", asset->name, size, asset->packed,
+                (double) size / asset->packed, (double) (middle - start) / loads,
+                (double) (end - middle) / loads);
+    }
+}
+
+/* the offsets of a wave across the lines of the screen, a whole wave over 32 */
+static const signed char bench_wave[32] = {
+    0, 1, 2, 2, 3, 3, 4, 4, 4, 4, 4, 3, 3, 2, 2, 1,
+    0, -1, -2, -2, -3, -3, -4, -4, -4, -4, -4, -3, -3, -2, -2, -1
+};
+
+/* the background color the gradient runs through, which the world map uses a lot */
+#define BENCH_GRADIENT_COLOR 1
+
+/* the state of a raster run, shared with the function called each frame */
+static struct {
+    unsigned short color;
+    unsigned long checked;
+    unsigned long bad_lines;
+    unsigned long bad_ends;
+    unsigned long long build_ns;
+} bench_raster_state;
+
+/* draw a frame one line at a time with the registers each effect's table has
+ * for that line set by hand, then start the effects again from the top */
+static void bench_raster_expected(unsigned short* expected) {
+    static unsigned short pixels[RENDER_WIDTH * RENDER_HEIGHT];
+    for (int index = 0; index < RASTER_EFFECTS; index++) {
+        dma_hblank_stop(DMA_HBLANK_RASTER + index);
+    }
+
+    for (int y = 0; y < RENDER_HEIGHT; y++) {
+        for (int index = 0; index < RASTER_EFFECTS; index++) {
+            struct RasterEffect* effect = &game.raster.effects[index];
+            const unsigned short* table = effect->tables[effect->front];
+            for (int unit = 0; unit < effect->units; unit++) {
+                ((volatile unsigned short*) effect->dest)[unit] = table[y * effect->units + unit];
+            }
+        }
+        render_frame(pixels);
+        memcpy(expected + y * RENDER_WIDTH, pixels + y * RENDER_WIDTH,
+                RENDER_WIDTH * sizeof(unsigned short));
+    }
+
+    /* this isn't another frame shown, so it isn't counted */
+    unsigned long shown = game.raster.frames_total;
+    raster_show(&game.raster);
+    game.raster.frames_total = shown;
+}
+
+/* check some of the frames the game drew with its effects, then build the
+ * tables for the next, which game_draw shows - the wave moves up a line each
+ * frame */
+static void bench_raster_frame(unsigned long frame) {
+    static unsigned short pixels[RENDER_WIDTH * RENDER_HEIGHT];
+    static unsigned short expected[RENDER_WIDTH * RENDER_HEIGHT];
+    volatile unsigned short* scroll = (volatile unsigned short*) IO_ADDRESS(0x010);
+    volatile unsigned short* color =
+        (volatile unsigned short*) PALETTE_ADDRESS(BENCH_GRADIENT_COLOR * 2);
+
+    if (frame == 0) {
+        bench_raster_state.color = *color;
+        raster_set(&game.raster, 0, scroll, 2);
+        raster_set(&game.raster, 1, color, 1);
+    } else if (frame % 60 == 1) {
+        bench_raster_expected(expected);
+        render_frame(pixels);
+        for (int y = 0; y < RENDER_HEIGHT; y++) {
+            bench_raster_state.bad_lines += memcmp(expected + y * RENDER_WIDTH,
+                    pixels + y * RENDER_WIDTH, RENDER_WIDTH * sizeof(unsigned short)) != 0;
+        }
+
+        /* the spare line puts the first line's values back as the frame ends */
+        const unsigned short* waves = game.raster.effects[0].tables[game.raster.effects[0].front];
+        const unsigned short* colors = game.raster.effects[1].tables[game.raster.effects[1].front];
+        bench_raster_state.bad_ends += scroll[0] != waves[0] || scroll[1] != waves[1] ||
+            *color != colors[0];
+        bench_raster_state.checked++;
+    }
+
+    unsigned long long start = host_clock();
+    unsigned short* waves = raster_build(&game.raster, 0);
+    for (int y = 0; y < RENDER_HEIGHT; y++) {
+        waves[y * 2] = game.camera.x + bench_wave[(y + frame) & 31];
+        waves[y * 2 + 1] = game.camera.y;
+    }
+
+    /* from the color as it is at the top to full red at the bottom */
+    unsigned short* colors = raster_build(&game.raster, 1);
+    for (int y = 0; y < RENDER_HEIGHT; y++) {
+        colors[y] = (bench_raster_state.color & ~0x1f) | (y * 31 / (RENDER_HEIGHT - 1));
+    }
+    bench_raster_state.build_ns += host_clock() - start;
+}
+
+/* play the scripted run with a wave and a gradient on every frame */
+static int bench_raster(unsigned long frames) {
+    memset(&bench_raster_state, 0, sizeof(bench_raster_state));
+    bench_run_log(frames, BENCH_LIVE, bench_raster_frame);
+
+    printf("%lu frames with effects on, %lu tables built\n", game.raster.frames_total,
+            game.raster.built_total);
+    printf("%.1f ns/frame building the tables\n", (double) bench_raster_state.build_ns / frames);
+    printf("%lu frames checked line by line: %lu lines differ, %lu frames ended "
+            "without the first line's values back\n", bench_raster_state.checked,
+            bench_raster_state.bad_lines, bench_raster_state.bad_ends);
+    return bench_raster_state.bad_lines || bench_raster_state.bad_ends;
+}
+
+/* the state of a render run, shared with the function called each frame */
+static struct {
+    unsigned long frames;
+    FILE* golden;
+    FILE* out;
+    const char* png;
+    unsigned long long ns;
+    unsigned long long hash;
+    unsigned long mismatches;
+    long first_mismatch;
+} bench_render_state;
+
+/* draw the frame the game just put in video memory, and hash it */
+static void bench_render_frame(unsigned long frame) {
+    static unsigned short pixels[RENDER_WIDTH * RENDER_HEIGHT];
+
+    unsigned long long start = host_clock();
+    render_frame(pixels);
+    unsigned long long hash = render_hash(pixels);
+    bench_render_state.ns += host_clock() - start;
+    bench_render_state.hash = hash;
+
+    int save = 0;
+    if (bench_render_state.golden) {
+        unsigned long long expected;
+        if (fscanf(bench_render_state.golden, "%llx", &expected) != 1 || expected != hash) {
+            if (bench_render_state.mismatches++ == 0) {
+                bench_render_state.first_mismatch = frame;
+            }
+            save = 1;
+        }
+    } else {
+        if (bench_render_state.out) {
+            fprintf(bench_render_state.out, "%016llx\n", hash);
+        }
+
+        /* with nothing to check against, keep the last frame to look at */
+        save = frame == bench_render_state.frames - 1;
+    }
+
+    if (save && bench_render_state.png) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s%06lu.png", bench_render_state.png, frame);
+        if (!render_png(path, pixels)) {
+            printf("can't write %s\n", path);
+        }
+    }
+}
+
+/* draw the scripted run, checking or writing the hashes of its frames */
+static int bench_render(unsigned long frames, const char* hashes, const char* png) {
+    bench_render_state.frames = frames;
+    bench_render_state.golden = hashes ? fopen(hashes, "r") : NULL;
+    bench_render_state.out = (hashes && !bench_render_state.golden) ? fopen(hashes, "w") : NULL;
+    bench_render_state.png = png;
+    bench_render_state.ns = 0;
+    bench_render_state.mismatches = 0;
+    bench_render_state.first_mismatch = -1;
+
+    bench_run_log(frames, BENCH_LIVE, bench_render_frame);
+
+    printf("%lu frames drawn in %.1f ns/frame, %.0f frames/sec, last hash %016llx\n",
+            frames, (double) bench_render_state.ns / frames,
+            frames / (bench_render_state.ns / 1e9), bench_render_state.hash);
+    if (bench_render_state.golden) {
+        fclose(bench_render_state.golden);
+        if (bench_render_state.mismatches) {
+            printf("%lu frames differ from %s, the first is frame %ld\n",
+                    bench_render_state.mismatches, hashes, bench_render_state.first_mismatch);
+            return 1;
+        }
+        printf("every frame matches %s\n", hashes);
+    } else if (bench_render_state.out) {
+        fclose(bench_render_state.out);
+        printf("hashes written to %s\n", hashes);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "broadphase") == 0) {
+        bench_broadphase();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "collision") == 0) {
+        return bench_collision();
+    }
+    if (argc > 1 && strcmp(argv[1], "mux") == 0) {
+        bench_mux();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "raster") == 0) {
+        return bench_raster(argc > 2 ? strtoul(argv[2], NULL, 10) : 600);
+    }
+    if (argc > 1 && strcmp(argv[1], "sort") == 0) {
+        bench_sort();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "assets") == 0) {
+        bench_asset_loads();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "replay") == 0) {
+        /* a 10 minute run by default */
+        return bench_replay(argc > 2 ? strtoul(argv[2], NULL, 10) : 36000);
+    }
+    if (argc > 1 && strcmp(argv[1], "render") == 0) {
+        return bench_render(argc > 2 ? strtoul(argv[2], NULL, 10) : 3600,
+                argc > 3 ? argv[3] : NULL, argc > 4 ? argv[4] : NULL);
+    }
+
+    unsigned long frames = 2000000;
+    if (argc > 1) {
+        frames = strtoul(argv[1], NULL, 10);
+    }
+
+    /* first the whole frame with no timers in the way */
+    host_bench_enabled = 0;
+    unsigned long long total = bench_run(frames);
+    printf("%lu frames in %.3f s: %.0f frames/sec, %.1f ns/frame\n", frames,
+            total / 1e9, frames / (total / 1e9), (double) total / frames);
+    printf("%.1f bytes copied to OAM per frame\n", (double) game.sprite_table.oam_bytes_total / frames);
+    printf("%.1f sprites in OAM per frame, at most %d\n",
+            (double) game.sprite_table.shown_total / frames, game.sprite_table.shown_max);
+    printf("%lu frames multiplexed, %lu sprites too tall for them, %lu sprites and %lu "
+            "animations refused\n", game.sprite_table.mux_frames, game.sprite_table.too_tall,
+            game.sprite_table.refused, game.animator.refused);
+    printf("%-6s %10s %8s %8s\n", "band", "sprites", "most", "dropped");
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        printf("%-6d %10.1f %8d %8lu\n", band, (double) game.sprite_table.band_total[band] / frames,
+                game.sprite_table.band_max[band], game.sprite_table.band_dropped[band]);
+    }
+    printf("%.1f map entries streamed per frame, at most %u in one\n",
+            (double) game.stream.uploaded_total / frames, game.stream.uploaded_max);
+    printf("%.1f sprite tile bytes streamed per frame, at most %u in one\n",
+            (double) game.animator.bytes_total / frames, game.animator.bytes_max);
+    printf("%.1f bytes queued and %.1f copied per vblank, at most %u in one (budget %u)\n",
+            (double) game.dma.queued_total / frames, (double) game.dma.flushed_total / frames,
+            game.dma.flushed_max, game.dma.budget);
+    printf("%.2f timers fired and %.2f moved down the wheel per frame\n",
+            (double) game.timers.fired_total / frames,
+            (double) game.timers.cascaded_total / frames);
+    printf("%lu slimes spawned, %lu spawns lost to a full queue\n",
+            game.slimes.spawns.fired, game.slimes.spawns.dropped);
+    printf("%lu vblanks left copies for the next, %lu ran into the screen, %lu copies "
+            "turned away by a full queue\n", game.dma.deferred, game.dma.late, game.dma.full);
+
+    /* find what an empty section measures as, so it can be taken out */
+    host_bench_enabled = 1;
+    host_bench_ns[BENCH_CALC_WAVE] = 0;
+    host_bench_calls[BENCH_CALC_WAVE] = 0;
+    for (int i = 0; i < 1000000; i++) {
+        host_bench_begin(BENCH_CALC_WAVE);
+        host_bench_end(BENCH_CALC_WAVE);
+    }
+    double overhead = (double) host_bench_ns[BENCH_CALC_WAVE] / host_bench_calls[BENCH_CALC_WAVE];
+
+    /* then again with each section timed */
+    for (int i = 0; i < NUM_BENCH_SECTIONS; i++) {
+        host_bench_ns[i] = 0;
+        host_bench_calls[i] = 0;
+    }
+    bench_run(frames);
+    host_bench_enabled = 0;
+
+    printf("%-20s %12s\n", "section", "ns/frame");
+    for (int i = 0; i < NUM_BENCH_SECTIONS; i++) {
+        double ns = host_bench_ns[i] - overhead * host_bench_calls[i];
+        if (ns < 0) {
+            ns = 0;
+        }
+        printf("%-20s %12.1f\n", bench_names[i], ns / frames);
+    }
+    printf("(timer overhead of %.1f ns per section removed)\n", overhead);
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * camera.h
+ * the part of the world the screen shows - everything in the game is kept in
+ * world pixels, and only turned into screen ones when its sprite is placed
+ */
+
+#pragma once
+#ifndef CAMERA_H
+#define CAMERA_H
+
+/* the size of the screen the camera fills */
+#define CAMERA_WIDTH 240
+#define CAMERA_HEIGHT 160
+
+/* the world pixel at the top left of the screen, which is also the scroll of
+ * the background */
+struct Camera {
+    int x, y;
+};
+
+/* whether any of a w by h box at world (x, y) is on the screen */
+static inline int camera_sees(const struct Camera* camera, int x, int y, int w, int h) {
+    return x + w > camera->x && x < camera->x + CAMERA_WIDTH &&
+        y + h > camera->y && y < camera->y + CAMERA_HEIGHT;
+}
+
+/* move the camera along with a w by h box which has just moved by (dx, dy) from
+ * world (x, y), if it was already within border pixels of the edge it moved
+ * towards - so it stays where it was on the screen */
+static inline void camera_follow(struct Camera* camera, int x, int y, int dx, int dy,
+        int w, int h, int border) {
+    x -= camera->x;
+    y -= camera->y;
+    if ((dx < 0 && x < border) || (dx > 0 && x > CAMERA_WIDTH - w - border)) {
+        camera->x += dx;
+    }
+    if ((dy < 0 && y < border) || (dy > 0 && y > CAMERA_HEIGHT - h - border)) {
+        camera->y += dy;
+    }
+}
+
+#endif
@@ -0,0 +1,15 @@
+.global lz77_uncomp_vram
+.global rl_uncomp_vram
+
+@ unpack LZ77 data at r0 into VRAM at r1
+lz77_uncomp_vram:
+	swi 0x120000
+	mov pc, lr
+
+@ unpack run length data at r0 into VRAM at r1
+rl_uncomp_vram:
+	swi 0x150000
+	mov pc, lr
+
+@ no executable stack
+	.section .note.GNU-stack,"",%progbits
@@ -0,0 +1,172 @@
+/*
+ * dma.c
+ * a queue of copies to video memory, carried out by DMA during vblank, and
+ * copies made a little at a time at each hblank while the screen is drawn
+ */
+
+#include "gba.h"
+#include "dma.h"
+
+/* flag for turning on DMA */
+#define DMA_ENABLE 0x80000000
+
+/* flags for the sizes to transfer, 16 or 32 bits */
+#define DMA_16 0x00000000
+#define DMA_32 0x04000000
+
+/* flags to start at each hblank rather than right away, and to go again at
+ * the next one rather than turning off */
+#define DMA_AT_HBLANK 0x20000000
+#define DMA_REPEAT 0x02000000
+
+/* flag for the destination to count up during each copy and go back to where
+ * it started for the next */
+#define DMA_DEST_RELOAD 0x00600000
+
+/* the registers of each channel, 12 bytes apart: source, destination, and
+ * count and control */
+#define DMA_CHANNEL(channel) ((volatile unsigned int*) IO_ADDRESS(0x0B0 + (channel) * 12))
+
+/* pointer to the DMA source location */
+volatile unsigned int* dma_source = (volatile unsigned int*) IO_ADDRESS(0x0D4);
+
+/* pointer to the DMA destination location */
+volatile unsigned int* dma_destination = (volatile unsigned int*) IO_ADDRESS(0x0D8);
+
+/* pointer to the DMA count/control */
+volatile unsigned int* dma_count = (volatile unsigned int*) IO_ADDRESS(0x0DC);
+
+/* the line being drawn, 160 and up is vblank */
+static volatile unsigned short* dma_scanline = (volatile unsigned short*) IO_ADDRESS(0x006);
+
+void dma_copy(volatile void* dest, const volatile void* source, unsigned int bytes) {
+    unsigned int control;
+    if ((((unsigned long) dest | (unsigned long) source | bytes) & 3) == 0) {
+        control = (bytes / 4) | DMA_32 | DMA_ENABLE;
+    } else {
+        control = (bytes / 2) | DMA_16 | DMA_ENABLE;
+    }
+
+#ifdef HOST
+    /* the host has no DMA controller, and pointers don't fit the registers */
+    host_dma((void*) dest, (const void*) source, control);
+#else
+    *dma_source = (unsigned int) source;
+    *dma_destination = (unsigned int) dest;
+    *dma_count = control;
+#endif
+}
+
+void dma_queue_init(struct DmaQueue* queue, unsigned int budget) {
+    queue->head = 0;
+    queue->count = 0;
+    queue->budget = budget;
+    queue->queued_total = 0;
+    queue->flushed_last = 0;
+    queue->flushed_max = 0;
+    queue->flushed_total = 0;
+    queue->deferred = 0;
+    queue->late = 0;
+    queue->full = 0;
+}
+
+int dma_queue_add(struct DmaQueue* queue, volatile void* dest,
+        const volatile void* source, unsigned int bytes) {
+    /* copying now would be in the middle of the frame, so the caller has to
+     * try again next frame */
+    if (queue->count == DMA_QUEUE_SIZE) {
+        queue->full++;
+        return 0;
+    }
+    queue->queued_total += bytes;
+
+    struct DmaTransfer* transfer =
+        &queue->transfers[(queue->head + queue->count) % DMA_QUEUE_SIZE];
+    transfer->dest = dest;
+    transfer->source = source;
+    transfer->bytes = bytes;
+    queue->count++;
+    return 1;
+}
+
+void dma_queue_drop(struct DmaQueue* queue) {
+    queue->head = 0;
+    queue->count = 0;
+}
+
+void dma_queue_flush(struct DmaQueue* queue) {
+    unsigned int flushed = 0;
+
+    while (queue->count > 0) {
+        struct DmaTransfer* transfer = &queue->transfers[queue->head];
+        unsigned int left = queue->budget - flushed;
+
+        /* do as much of a copy which doesn't fit as the budget allows, in whole
+         * words so the rest keeps its alignment, and leave the rest */
+        if (transfer->bytes > left) {
+            unsigned int part = left & ~3u;
+            if (part > 0) {
+                dma_copy(transfer->dest, transfer->source, part);
+                transfer->dest = (volatile char*) transfer->dest + part;
+                transfer->source = (const volatile char*) transfer->source + part;
+                transfer->bytes -= part;
+                flushed += part;
+            }
+            break;
+        }
+
+        dma_copy(transfer->dest, transfer->source, transfer->bytes);
+        flushed += transfer->bytes;
+        queue->head = (queue->head + 1) % DMA_QUEUE_SIZE;
+        queue->count--;
+    }
+
+    if (queue->count > 0) {
+        queue->deferred++;
+    }
+    if (*dma_scanline < 160) {
+        queue->late++;
+    }
+
+    queue->flushed_last = flushed;
+    if (flushed > queue->flushed_max) {
+        queue->flushed_max = flushed;
+    }
+    queue->flushed_total += flushed;
+}
+
+/* set a channel going with a control word */
+static void dma_hblank_program(int channel, volatile void* dest, const volatile void* source,
+        unsigned int control) {
+#ifdef HOST
+    host_hblank_dma(channel, (void*) dest, (const void*) source, control);
+#else
+    volatile unsigned int* registers = DMA_CHANNEL(channel);
+
+    /* it has to be off for the new addresses to be picked up */
+    registers[2] = 0;
+    registers[0] = (unsigned int) source;
+    registers[1] = (unsigned int) dest;
+    registers[2] = control;
+#endif
+}
+
+void dma_hblank_start(int channel, volatile void* dest, const volatile void* source,
+        unsigned int words) {
+    dma_hblank_program(channel, dest, source,
+            words | DMA_32 | DMA_AT_HBLANK | DMA_REPEAT | DMA_ENABLE);
+}
+
+void dma_hblank_registers(int channel, volatile void* dest, const volatile void* source,
+        unsigned int halfwords) {
+    dma_hblank_program(channel, dest, source,
+            halfwords | DMA_16 | DMA_DEST_RELOAD | DMA_AT_HBLANK | DMA_REPEAT | DMA_ENABLE);
+}
+
+void dma_hblank_stop(int channel) {
+#ifdef HOST
+    host_hblank_dma(channel, 0, 0, 0);
+#else
+    DMA_CHANNEL(channel)[2] = 0;
+#endif
+}
@@ -0,0 +1,91 @@
+/*
+ * dma.h
+ * a queue of copies to video memory, carried out by DMA during vblank, and
+ * copies made a little at a time at each hblank while the screen is drawn
+ */
+
+#pragma once
+#ifndef DMA_H
+#define DMA_H
+
+/* the most copies which can be waiting at once */
+#define DMA_QUEUE_SIZE 128
+
+/* the bytes copied in one vblank by default - vblank is 83776 cycles, and a
+ * word of DMA from the ROM to VRAM takes about 8, so this leaves most of it
+ * for the map stream and the rest of game_draw */
+#define DMA_BUDGET 6144
+
+/* a copy waiting for vblank, the source has to stay the same until then */
+struct DmaTransfer {
+    volatile void* dest;
+    const volatile void* source;
+    unsigned int bytes;
+};
+
+/* copies queued up during a frame to be done at the next vblank - when more is
+ * queued than the budget allows the rest waits for the vblank after */
+struct DmaQueue {
+    struct DmaTransfer transfers[DMA_QUEUE_SIZE];
+    int head;
+    int count;
+
+    /* the most bytes copied in one vblank */
+    unsigned int budget;
+
+    /* the bytes queued in total, and copied at the last vblank, the most at
+     * any one, and in total */
+    unsigned long queued_total;
+    unsigned int flushed_last;
+    unsigned int flushed_max;
+    unsigned long flushed_total;
+
+    /* the vblanks which left copies for the next one, the ones which were
+     * still copying once the screen started drawing, and the copies which were
+     * turned away because the queue was full */
+    unsigned long deferred;
+    unsigned long late;
+    unsigned long full;
+};
+
+/* the DMA channel which copies sprites into OAM at hblank - the vblank copies
+ * use channel 3, which has the lowest priority, and the raster effects use
+ * the ones from DMA_HBLANK_RASTER up */
+#define DMA_HBLANK_SPRITES 2
+#define DMA_HBLANK_RASTER 0
+
+/* copy right away, with 32 bit transfers when everything is word aligned and
+ * 16 bit ones when not - the size has to be a multiple of 2 */
+void dma_copy(volatile void* dest, const volatile void* source, unsigned int bytes);
+
+/* empty a queue, and set how many bytes it copies each vblank */
+void dma_queue_init(struct DmaQueue* queue, unsigned int budget);
+
+/* queue up a copy for the next vblank, returns 0 if the queue is full and
+ * it has to be queued again later */
+int dma_queue_add(struct DmaQueue* queue, volatile void* dest,
+        const volatile void* source, unsigned int bytes);
+
+/* throw the queued copies away without doing them, for a game which is never
+ * drawn */
+void dma_queue_drop(struct DmaQueue* queue);
+
+/* do the queued copies in order until the budget runs out, this must be
+ * called during vblank */
+void dma_queue_flush(struct DmaQueue* queue);
+
+/* start a channel copying words words from source to dest at every hblank,
+ * each one carrying on from where the last stopped, until it is stopped */
+void dma_hblank_start(int channel, volatile void* dest, const volatile void* source,
+        unsigned int words);
+
+/* start a channel copying halfwords halfwords from source to the same
+ * registers (or palette entries) at dest at every hblank, the source carrying
+ * on from where the last stopped, until it is stopped */
+void dma_hblank_registers(int channel, volatile void* dest, const volatile void* source,
+        unsigned int halfwords);
+
+/* stop a channel's hblank copies */
+void dma_hblank_stop(int channel);
+
+#endif
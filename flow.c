@@ -0,0 +1,161 @@
+/*
+ * flow.c
+ * shared distance field which leads enemies to the player
+ */
+
+#include "flow.h"
+
+/* the four neighbours of a tile */
+static const int flow_dx[4] = {1, -1, 0, 0};
+static const int flow_dy[4] = {0, 0, 1, -1};
+
+/* where map tile (x, y) is in a buffer's window, or -1 if it is outside */
+static int flow_index(const struct FlowField* flow, int buffer, int x, int y) {
+    int wx = (x - flow->left[buffer]) & (flow->map->width - 1);
+    int wy = (y - flow->top[buffer]) & (flow->map->height - 1);
+    if (wx >= FLOW_WIDTH || wy >= FLOW_HEIGHT) {
+        return -1;
+    }
+    return wy * FLOW_WIDTH + wx;
+}
+
+void flow_init(struct FlowField* flow, const struct CollisionMap* map) {
+    flow->map = map;
+    for (int i = 0; i < FLOW_TILES; i++) {
+        flow->distance[0][i] = FLOW_UNREACHED;
+        flow->distance[1][i] = FLOW_UNREACHED;
+    }
+    flow->left[0] = flow->left[1] = 0;
+    flow->top[0] = flow->top[1] = 0;
+    flow->done = 0;
+    flow->target_x = -1;
+    flow->target_y = -1;
+    flow->building = 0;
+    flow->head = 0;
+    flow->tail = 0;
+}
+
+/* clear the buffer not in use, work out where sprites fit in its window and put
+ * the target in the queue */
+static void flow_start(struct FlowField* flow, int x, int y, int left, int top) {
+    int buffer = !flow->done;
+    unsigned char* distance = flow->distance[buffer];
+    for (int i = 0; i < FLOW_TILES; i++) {
+        distance[i] = FLOW_UNREACHED;
+    }
+    flow->left[buffer] = left;
+    flow->top[buffer] = top;
+
+    /* a sprite with its corner on a tile covers that tile and the ones right,
+     * below and diagonal from it, so a whole row of the window is four loads */
+    for (int wy = 0; wy < FLOW_HEIGHT; wy++) {
+        unsigned int blocked =
+            map_row_bits(flow->map, left, top + wy) |
+            map_row_bits(flow->map, left + 1, top + wy) |
+            map_row_bits(flow->map, left, top + wy + 1) |
+            map_row_bits(flow->map, left + 1, top + wy + 1);
+        flow->open[wy] = ~blocked;
+    }
+
+    int target = flow_index(flow, buffer, x, y);
+    distance[target] = 0;
+    flow->queue[0] = target;
+    flow->head = 0;
+    flow->tail = 1;
+    flow->building = 1;
+    flow->build_x = x;
+    flow->build_y = y;
+}
+
+void flow_update(struct FlowField* flow, int x, int y, int left, int top, int budget) {
+    x &= flow->map->width - 1;
+    y &= flow->map->height - 1;
+    left &= flow->map->width - 1;
+    top &= flow->map->height - 1;
+
+    /* only search again once the player or the window has moved a tile */
+    if (!flow->building) {
+        if (x == flow->target_x && y == flow->target_y &&
+                left == flow->left[flow->done] && top == flow->top[flow->done]) {
+            return;
+        }
+
+        /* nothing to search for if the player is off the window */
+        int wx = (x - left) & (flow->map->width - 1);
+        int wy = (y - top) & (flow->map->height - 1);
+        if (wx >= FLOW_WIDTH || wy >= FLOW_HEIGHT) {
+            return;
+        }
+        flow_start(flow, x, y, left, top);
+    }
+
+    unsigned char* distance = flow->distance[!flow->done];
+    while (budget-- > 0 && flow->head < flow->tail) {
+        int tile = flow->queue[flow->head++];
+        int tx = tile & (FLOW_WIDTH - 1);
+        int ty = tile / FLOW_WIDTH;
+        int next = distance[tile] + 1;
+        if (next >= FLOW_UNREACHED) {
+            continue;
+        }
+
+        for (int n = 0; n < 4; n++) {
+            /* the search stays inside the window */
+            int nx = tx + flow_dx[n];
+            int ny = ty + flow_dy[n];
+            if (nx < 0 || nx >= FLOW_WIDTH || ny < 0 || ny >= FLOW_HEIGHT) {
+                continue;
+            }
+
+            int neighbour = ny * FLOW_WIDTH + nx;
+            if (distance[neighbour] != FLOW_UNREACHED) {
+                continue;
+            }
+
+            /* the whole sprite has to fit with its corner on the tile */
+            if (!(flow->open[ny] & (1u << nx))) {
+                continue;
+            }
+
+            distance[neighbour] = next;
+            flow->queue[flow->tail++] = neighbour;
+        }
+    }
+
+    /* once the queue runs dry the new field is ready to follow */
+    if (flow->head >= flow->tail) {
+        flow->done = !flow->done;
+        flow->target_x = flow->build_x;
+        flow->target_y = flow->build_y;
+        flow->building = 0;
+    }
+}
+
+int flow_direction(const struct FlowField* flow, int x, int y, int* dx, int* dy) {
+    const unsigned char* distance = flow->distance[flow->done];
+    int here = flow_index(flow, flow->done, x, y);
+    if (here < 0) {
+        return 0;
+    }
+    int best = distance[here];
+    if (best == 0 || best == FLOW_UNREACHED) {
+        return 0;
+    }
+
+    /* downhill is towards the target */
+    int found = 0;
+    for (int n = 0; n < 4; n++) {
+        int neighbour = flow_index(flow, flow->done, x + flow_dx[n], y + flow_dy[n]);
+        if (neighbour < 0) {
+            continue;
+        }
+        int d = distance[neighbour];
+        if (d < best) {
+            best = d;
+            *dx = flow_dx[n];
+            *dy = flow_dy[n];
+            found = 1;
+        }
+    }
+    return found;
+}
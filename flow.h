@@ -0,0 +1,68 @@
+/*
+ * flow.h
+ * shared distance field which leads enemies to the player
+ */
+
+#pragma once
+#ifndef FLOW_H
+#define FLOW_H
+
+#include "map.h"
+
+/* the field covers a 32x32 tile window of the map, which moves with the camera */
+#define FLOW_WIDTH 32
+#define FLOW_HEIGHT 32
+#define FLOW_TILES (FLOW_WIDTH * FLOW_HEIGHT)
+
+/* the distance stored for tiles the search hasn't reached */
+#define FLOW_UNREACHED 255
+
+/* the most tiles the search gets through in one frame */
+#define FLOW_BUDGET 128
+
+/* a breadth first search out from the player's tile, giving each tile of the
+ * window the number of steps a 16x16 sprite with its corner there needs to get
+ * to the player. it is built a few tiles at a time into one buffer while the
+ * enemies follow the finished one in the other */
+struct FlowField {
+    const struct CollisionMap* map;
+
+    unsigned char distance[2][FLOW_TILES];
+
+    /* the map tile at the top left of each buffer's window */
+    int left[2];
+    int top[2];
+
+    /* a bit for each tile of the window being searched that a 16x16 sprite
+     * fits on, one word per row */
+    unsigned int open[FLOW_HEIGHT];
+
+    /* which buffer is finished, and the map tile it leads to */
+    int done;
+    int target_x;
+    int target_y;
+
+    /* the search being built: whether there is one, its target and the queue
+     * of window tiles to visit */
+    int building;
+    int build_x;
+    int build_y;
+    int head;
+    int tail;
+    unsigned short queue[FLOW_TILES];
+};
+
+/* start with nothing reached on the map */
+void flow_init(struct FlowField* flow, const struct CollisionMap* map);
+
+/* carry on the search towards tile (x, y) of the map for up to budget tiles,
+ * starting a new search once the last one finishes if the target or the
+ * window, whose top left is tile (left, top), has moved */
+void flow_update(struct FlowField* flow, int x, int y, int left, int top, int budget);
+
+/* the direction to step from tile (x, y) of the map to get closer to the
+ * target, returns 0 if the tile is off the field, hasn't been reached or is
+ * the target */
+int flow_direction(const struct FlowField* flow, int x, int y, int* dx, int* dy);
+
+#endif
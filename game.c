@@ -6,15 +6,18 @@
 #define SCREEN_WIDTH 240
 #define SCREEN_HEIGHT 160
 
-/* include the background image we are using */
-#include "GBAProjectBackground1.h"
-#include "background.h"
+/* the memory regions of the hardware */
+#include "gba.h"
 
-/* include the sprite image we are using */
-#include "Sprites.h"
+/* the game state structures */
+#include "game.h"
 
-/* include the tile map we are using */
-#include "ForestBackground.h"
+/* the collision layer of the tile map */
+#include "map.h"
+
+/* the compressed background and tile map, and the sprite sheet */
+#include "asset.h"
+#include "assets.h"
 
 /* the tile mode flags needed for display control register */
 #define MODE0 0x00
@@ -27,35 +30,29 @@
 
 
 /* the control registers for the four tile layers */
-volatile unsigned short* bg0_control = (volatile unsigned short*) 0x4000008;
-
-/* palette is always 256 colors */
-#define PALETTE_SIZE 256
-
-/* there are 128 sprites on the GBA */
-#define NUM_SPRITES 128
+volatile unsigned short* bg0_control = (volatile unsigned short*) IO_ADDRESS(0x008);
 
 /* the display control pointer points to the gba graphics register */
-volatile unsigned long* display_control = (volatile unsigned long*) 0x4000000;
+volatile unsigned int* display_control = (volatile unsigned int*) IO_ADDRESS(0x000);
 
 /* the memory location which controls sprite attributes */
-volatile unsigned short* sprite_attribute_memory = (volatile unsigned short*) 0x7000000;
+volatile unsigned short* sprite_attribute_memory = (volatile unsigned short*) OAM_ADDRESS(0x000);
 
 /* the memory location which stores sprite image data */
-volatile unsigned short* sprite_image_memory = (volatile unsigned short*) 0x6010000;
+volatile unsigned short* sprite_image_memory = (volatile unsigned short*) VRAM_ADDRESS(0x10000);
 
 /* the address of the color palettes used for backgrounds and sprites */
-volatile unsigned short* bg_palette = (volatile unsigned short*) 0x5000000;
-volatile unsigned short* sprite_palette = (volatile unsigned short*) 0x5000200;
+volatile unsigned short* bg_palette = (volatile unsigned short*) PALETTE_ADDRESS(0x000);
+volatile unsigned short* sprite_palette = (volatile unsigned short*) PALETTE_ADDRESS(0x200);
 
 /* the button register holds the bits which indicate whether each button has
  * been pressed - this has got to be volatile as well
  */
-volatile unsigned short* buttons = (volatile unsigned short*) 0x04000130;
+volatile unsigned short* buttons = (volatile unsigned short*) IO_ADDRESS(0x130);
 
 /* scrolling registers for backgrounds */
-volatile short* bg0_x_scroll = (unsigned short*) 0x4000010;
-volatile short* bg0_y_scroll = (unsigned short*) 0x4000012;
+volatile short* bg0_x_scroll = (volatile short*) IO_ADDRESS(0x010);
+volatile short* bg0_y_scroll = (volatile short*) IO_ADDRESS(0x012);
 
 /* the bit positions indicate each button - the first bit is for A, second for
  * B, and so on, each constant below can be ANDED into the register to get the
@@ -73,105 +70,138 @@ volatile short* bg0_y_scroll = (unsigned short*) 0x4000012;
 
 /* the scanline counter is a memory cell which is updated to indicate how
  * much of the screen has been drawn */
-volatile unsigned short* scanline_counter = (volatile unsigned short*) 0x4000006;
+volatile unsigned short* scanline_counter = (volatile unsigned short*) IO_ADDRESS(0x006);
+
+/* the interrupt registers: which interrupts are enabled, which have fired, and
+ * the master switch for all of them */
+volatile unsigned short* interrupt_enable = (volatile unsigned short*) IO_ADDRESS(0x200);
+volatile unsigned short* interrupt_flags = (volatile unsigned short*) IO_ADDRESS(0x202);
+volatile unsigned short* interrupt_master = (volatile unsigned short*) IO_ADDRESS(0x208);
+
+/* the display status register, which chooses which display events interrupt */
+volatile unsigned short* display_status = (volatile unsigned short*) IO_ADDRESS(0x004);
+
+/* the BIOS jumps to the function stored here when an interrupt happens */
+volatile unsigned int* interrupt_vector = (volatile unsigned int*) IWRAM_ADDRESS(0x7ffc);
+
+/* the interrupt bits used in the enable and flags registers */
+#define INTERRUPT_VBLANK (1 << 0)
+#define INTERRUPT_VCOUNT (1 << 2)
+
+/* the bits in the display status register to interrupt at vblank, and when a
+ * line starts, with the line in the top byte */
+#define DISPLAY_VBLANK_INTERRUPT (1 << 3)
+#define DISPLAY_VCOUNT_INTERRUPT (1 << 5)
+#define DISPLAY_VCOUNT(line) ((line) << 8)
+
+/* the display control bit which lets OAM be written during hblank, at the cost
+ * of some of the time each line has for drawing sprites */
+#define DISPLAY_HBLANK_OAM 0x20
+
+/* these are in interrupt.s */
+void interrupt_handler();
+void vblank_intr_wait();
+
+/* the number of vblanks so far, counted by the interrupt handler */
+volatile unsigned int vblank_count = 0;
+
+/* the vblank the last frame was shown at, and how many frames were too slow to
+ * be ready for the vblank they should have been shown at */
+unsigned int frame_vblank = 0;
+unsigned int missed_frames = 0;
+
+/* set up the vblank interrupt which paces the game */
+void interrupt_init() {
+    /* turn interrupts off while they are set up */
+    *interrupt_master = 0;
 
-/* wait for the screen to be fully drawn so we can do something during vblank */
-void wait_vblank() {
-    /* wait until all 160 lines have been updated */
-    while (*scanline_counter < 160) { }
+#ifndef HOST
+    *interrupt_vector = (unsigned int) interrupt_handler;
+#endif
+
+    /* ask the display for an interrupt at each vblank */
+    *display_status |= DISPLAY_VBLANK_INTERRUPT;
+    *interrupt_enable |= INTERRUPT_VBLANK;
+
+    /* and turn them back on */
+    *interrupt_master = 1;
+
+    frame_vblank = vblank_count;
+    missed_frames = 0;
 }
 
-/* this function checks whether a particular button has been pressed */
-unsigned char button_pressed(unsigned short button) {
-    /* and the button register with the button constant we want */
-    unsigned short pressed = *buttons & button;
+/* sleep until the next vblank so the game runs at a steady 60 frames a second,
+ * returns the number of vblanks missed because the frame took too long */
+int wait_vblank() {
+    /* the CPU is halted until the interrupt wakes it */
+    vblank_intr_wait();
+
+    /* every vblank after the one the last frame was shown at was missed */
+    int missed = vblank_count - frame_vblank - 1;
+    frame_vblank = vblank_count;
+    missed_frames += missed;
+    return missed;
+}
 
-    /* if this value is zero, then it's not pressed */
-    if (pressed == 0) {
-        return 1;
-    } else {
-        return 0;
-    }
+/* the keys held down right now - the register has a 0 bit for each one */
+unsigned short buttons_read() {
+    return ~*buttons & INPUT_KEYS;
 }
 
+/* the bytes of SRAM the keys are recorded to and played back from */
+#define INPUT_LOG_SIZE 0x8000
+
+/* emulators and flash carts look for this string to know the cartridge has SRAM */
+const char sram_id[] __attribute__((aligned(4))) = "SRAM_V113";
+
 /* return a pointer to one of the 4 character blocks (0-3) */
 volatile unsigned short* char_block(unsigned long block) {
     /* they are each 16K big */
-    return (volatile unsigned short*) (0x6000000 + (block * 0x4000));
+    return (volatile unsigned short*) VRAM_ADDRESS(block * 0x4000);
 }
 
 /* return a pointer to one of the 32 screen blocks (0-31) */
 volatile unsigned short* screen_block(unsigned long block) {
     /* they are each 2K big */
-    return (volatile unsigned short*) (0x6000000 + (block * 0x800));
+    return (volatile unsigned short*) VRAM_ADDRESS(block * 0x800);
 }
 
-/* flag for turning on DMA */
-#define DMA_ENABLE 0x80000000
-
-/* flags for the sizes to transfer, 16 or 32 bits */
-#define DMA_16 0x00000000
-#define DMA_32 0x04000000
-
-/* pointer to the DMA source location */
-volatile unsigned int* dma_source = (volatile unsigned int*) 0x40000D4;
-
-/* pointer to the DMA destination location */
-volatile unsigned int* dma_destination = (volatile unsigned int*) 0x40000D8;
-
-/* pointer to the DMA count/control */
-volatile unsigned int* dma_count = (volatile unsigned int*) 0x40000DC;
-
-/* copy data using DMA */
-void memcpy16_dma(unsigned short* dest, unsigned short* source, int amount) {
-    *dma_source = (unsigned int) source;
-    *dma_destination = (unsigned int) dest;
-    *dma_count = amount | DMA_16 | DMA_ENABLE;
-}
+/* the solid tiles of the world, worked out ahead of time by assetconv */
+const struct CollisionMap background_collision = {
+    asset_world_width, asset_world_height, asset_world_rows, asset_world_columns
+};
 
 /* function to setup background 0 for this program */
 void setup_background() {
 
-    /* load the palette from the image into palette memory*/
-    memcpy16_dma((unsigned short*) bg_palette, (unsigned short*) GBAProjectBackground1_palette, PALETTE_SIZE);
+    /* unpack the palette from the image into palette memory*/
+    asset_load(bg_palette, asset_background_palette);
 
-    /* load the image into char block 0 */
-    memcpy16_dma((unsigned short*) char_block(0), (unsigned short*) GBAProjectBackground1_data,
-            (GBAProjectBackground1_width * GBAProjectBackground1_height) / 2);
-            
+    /* unpack the image into char block 0 */
+    asset_load(char_block(0), asset_background_tiles);
 
     /* set all control the bits in this register */
     *bg0_control = 0 |    /* priority, 0 is highest, 3 is lowest */
         (0 << 2)  |       /* the char block the image data is stored in */
         (0 << 6)  |       /* the mosaic flag */
-        (1 << 7)  |       /* color mode, 0 is 16 colors, 1 is 256 colors */
+        (0 << 7)  |       /* color mode, 0 is 16 colors, 1 is 256 colors */
         (16 << 8) |       /* the screen block the tile data is stored in */
         (0 << 13) |       /* wrapping flag */
         (0 << 14);        /* bg size, 0 is 256x256 */
-        
 
-    /* load the tile data into screen block 16 */
-    memcpy16_dma((unsigned short*) screen_block(16), (unsigned short*) ForestBackground, ForestBackground_width * ForestBackground_height);
-    
+    /* the tile data in screen block 16 is streamed in from the world as it
+     * scrolls */
 }
 
 
-/* just kill time */
-void delay(unsigned int amount) {
-    for (int i = 0; i < amount * 10; i++);
-}
+/* the bit of the first attribute which disables a sprite that isn't affine */
+#define SPRITE_HIDDEN 0x200
 
-/* a sprite is a moveable image on the screen */
-struct Sprite {
-    unsigned short attribute0;
-    unsigned short attribute1;
-    unsigned short attribute2;
-    unsigned short attribute3;
-};
-
-/* array of all the sprites available on the GBA */
-struct Sprite sprites[NUM_SPRITES];
-int next_sprite_index = 0;
+/* mark a sprite as needing to be packed into OAM again */
+void sprite_mark_dirty(struct SpriteTable* table, struct Sprite* sprite) {
+    int index = sprite - table->sprites;
+    table->dirty[index >> 5] |= 1u << (index & 31);
+}
 
 /* the different sizes of sprites which are possible */
 enum SpriteSize {
@@ -190,11 +220,18 @@ enum SpriteSize {
 };
 
 /* function to initialize a sprite with its properties, and return a pointer */
-struct Sprite* sprite_init(int x, int y, enum SpriteSize size,
+struct Sprite* sprite_init(struct SpriteTable* table, int x, int y, enum SpriteSize size,
         int horizontal_flip, int vertical_flip, int tile_index, int priority) {
+    struct Sprite* sprites = table->sprites;
 
-    /* grab the next index */
-    int index = next_sprite_index++;
+    /* grab the next index, or once they have all gone the spare one, which is
+     * never shown */
+    int index = table->next;
+    if (index < NUM_SPRITES) {
+        table->next++;
+    } else {
+        table->refused++;
+    }
 
     /* setup the bits used for each shape/size possible */
     int size_bits, shape_bits;
@@ -221,7 +258,7 @@ struct Sprite* sprite_init(int x, int y, enum SpriteSize size,
         (0 << 8) |          /* rendering mode */
         (0 << 10) |         /* gfx mode */
         (0 << 12) |         /* mosaic */
-        (1 << 13) |         /* color mode, 0:16, 1:256 */
+        (0 << 13) |         /* color mode, 0:16, 1:256 */
         (shape_bits << 14); /* shape */
 
     /* set up the second attribute */
@@ -234,47 +271,428 @@ struct Sprite* sprite_init(int x, int y, enum SpriteSize size,
     /* setup the second attribute */
     sprites[index].attribute2 = tile_index |   // tile index */
         (priority << 10) | // priority */
-        (0 << 12);         // palette bank (only 16 color)*/
+        (0 << 12); // palette bank (only 16 color)*/
+
+    /* everything starts on the bottom layer */
+    table->layer[index] = 0;
 
     /* return pointer to this sprite */
+    sprite_mark_dirty(table, &sprites[index]);
     return &sprites[index];
 }
 
-/* update all of the spries on the screen */
-void sprite_update_all() {
-    /* copy them all over */
-    memcpy16_dma((unsigned short*) sprite_attribute_memory, (unsigned short*) sprites, NUM_SPRITES * 4);
+/* queue a copy of the entries from first up to (but not including) last into
+ * OAM, or if the queue is full mark them to go next frame */
+void sprite_flush(struct SpriteTable* table, struct DmaQueue* queue, int first, int last) {
+    if (!dma_queue_add(queue, sprite_attribute_memory + first * 4, &table->oam[first],
+            (last - first) * sizeof(struct Sprite))) {
+        for (int entry = first; entry < last; entry++) {
+            table->oam_dirty[entry >> 5] |= 1u << (entry & 31);
+        }
+        return;
+    }
+    table->oam_bytes_last += (last - first) * sizeof(struct Sprite);
+}
+
+/* what goes in an entry of OAM which isn't used */
+static const struct Sprite sprite_hidden = {SPRITE_HIDDEN, 0, 0, 0};
+
+/* put an entry into the copy of OAM, marking it if it changed */
+static void sprite_pack_entry(struct SpriteTable* table, int entry, const struct Sprite* sprite) {
+    struct Sprite* old = &table->oam[entry];
+    if (old->attribute0 != sprite->attribute0 || old->attribute1 != sprite->attribute1 ||
+            old->attribute2 != sprite->attribute2) {
+        *old = *sprite;
+        table->oam_dirty[entry >> 5] |= 1u << (entry & 31);
+    }
+}
+
+/* the height of each size of sprite, by shape then size */
+static const unsigned char sprite_heights[3][4] = {
+    {8, 16, 32, 64},
+    {8, 8, 16, 32},
+    {16, 32, 32, 64}
+};
+
+/* how many lines a sprite covers */
+static int sprite_height(const struct Sprite* sprite) {
+    return sprite_heights[(sprite->attribute0 >> 14) % 3][sprite->attribute1 >> 14];
+}
+
+/* the bits of the sort key sorted by each pass, and the buckets of a pass */
+#define SPRITE_SORT_BITS 4
+#define SPRITE_SORT_BUCKETS (1 << SPRITE_SORT_BITS)
+
+/* the sort works on each sprite's key above its index, so the keys travel
+ * with the sprites and are only ever read where they were written */
+#define SPRITE_SORT_KEY_SHIFT 16
+
+/* stably sort count sprites by one digit of their keys */
+static void sprite_sort_pass(const unsigned int* in, unsigned int* out, int count, int shift) {
+    shift += SPRITE_SORT_KEY_SHIFT;
+    int starts[SPRITE_SORT_BUCKETS];
+    for (int b = 0; b < SPRITE_SORT_BUCKETS; b++) {
+        starts[b] = 0;
+    }
+    for (int n = 0; n < count; n++) {
+        starts[(in[n] >> shift) & (SPRITE_SORT_BUCKETS - 1)]++;
+    }
+
+    int total = 0;
+    for (int b = 0; b < SPRITE_SORT_BUCKETS; b++) {
+        int size = starts[b];
+        starts[b] = total;
+        total += size;
+    }
+
+    for (int n = 0; n < count; n++) {
+        out[starts[(in[n] >> shift) & (SPRITE_SORT_BUCKETS - 1)]++] = in[n];
+    }
+}
+
+/* put count sprites in order front to back - the key is the layer above how
+ * far up the screen the sprite's feet are, so a radix sort on it a few bits at
+ * a time costs the same whatever the order they start in */
+static void sprite_sort(const struct SpriteTable* table, unsigned short* order, int count) {
+    unsigned int sprites[NUM_SPRITES];
+    unsigned int spare[NUM_SPRITES];
+
+    /* one sprite or none is already in order */
+    if (count < 2) {
+        return;
+    }
+
+    for (int n = 0; n < count; n++) {
+        int i = order[n];
+        unsigned short attribute0 = table->sprites[i].attribute0;
+
+        /* the y coordinate wraps around, so one poking out of the top is near 256 */
+        int feet = (attribute0 & 0xff) + sprite_height(&table->sprites[i]);
+        if ((attribute0 & 0xff) >= SCREEN_HEIGHT) {
+            feet -= 256;
+        }
+        if (feet < 0) {
+            feet = 0;
+        } else if (feet > 255) {
+            feet = 255;
+        }
+
+        unsigned int key = ((SPRITE_LAYERS - 1 - table->layer[i]) << 8) | (255 - feet);
+        sprites[n] = (key << SPRITE_SORT_KEY_SHIFT) | i;
+    }
+
+    /* the two digits of the depth, then the layer */
+    sprite_sort_pass(sprites, spare, count, 0);
+    sprite_sort_pass(spare, sprites, count, SPRITE_SORT_BITS);
+    sprite_sort_pass(sprites, spare, count, 2 * SPRITE_SORT_BITS);
+    for (int n = 0; n < count; n++) {
+        order[n] = spare[n] & ((1 << SPRITE_SORT_KEY_SHIFT) - 1);
+    }
+}
+
+/* the band a sprite's top is in, one poking out of the top wraps around to the
+ * bottom of the y coordinates but goes in the first */
+static int sprite_band(const struct Sprite* sprite) {
+    int y = sprite->attribute0 & 0xff;
+    if (y >= SCREEN_HEIGHT) {
+        return 0;
+    }
+    return y / SPRITE_BAND_HEIGHT;
+}
+
+/* where an entry of a band's half of OAM is kept - the first two bands are
+ * in the copy of OAM, and the rest wait to be copied in as the screen is drawn */
+static struct Sprite* sprite_band_entry(struct SpriteTable* table, int band, int entry) {
+    if (band < 2) {
+        return &table->oam[band * SPRITE_BAND_ENTRIES + entry];
+    }
+    return &table->mux.bands[table->mux.back][band - 2][entry];
+}
+
+/* share OAM between the bands of the screen, for when there are more sprites
+ * shown than it holds - a band which is full leaves out the ones furthest back,
+ * and sprites taller than SPRITE_MUX_HEIGHT are left out altogether */
+static int sprite_mux_pack(struct SpriteTable* table, const unsigned short* order, int count) {
+    int used[SPRITE_BANDS];
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        used[band] = 0;
+    }
+
+    for (int n = 0; n < count; n++) {
+        int i = order[n];
+        int band = sprite_band(&table->sprites[i]);
+        table->oam_entry[i] = SPRITE_NOT_SHOWN;
+
+        /* a taller one would have its entry copied over while it is drawn */
+        if (sprite_height(&table->sprites[i]) > SPRITE_MUX_HEIGHT) {
+            table->too_tall++;
+        } else if (used[band] == SPRITE_BAND_ENTRIES) {
+            table->band_dropped[band]++;
+        } else {
+            *sprite_band_entry(table, band, used[band]++) = table->sprites[i];
+        }
+    }
+
+    int shown = 0;
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        shown += used[band];
+        for (int entry = used[band]; entry < SPRITE_BAND_ENTRIES; entry++) {
+            *sprite_band_entry(table, band, entry) = sprite_hidden;
+        }
+    }
+    return shown;
+}
+
+/* pack the sprites which aren't hidden into the lowest entries of the copy of
+ * OAM, front to back, and disable the entries which were used last frame but
+ * aren't now - or if there are too many, spread them over the bands */
+void sprite_pack(struct SpriteTable* table) {
+    unsigned short order[NUM_SPRITES];
+    int shown = 0;
+    for (int i = 0; i < table->next; i++) {
+        if (table->sprites[i].attribute0 & SPRITE_HIDDEN) {
+            table->oam_entry[i] = SPRITE_NOT_SHOWN;
+        } else {
+            order[shown++] = i;
+        }
+    }
+
+    if (table->depth_sort) {
+        sprite_sort(table, order, shown);
+    }
+
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        table->band_last[band] = 0;
+    }
+    for (int n = 0; n < shown; n++) {
+        table->band_last[sprite_band(&table->sprites[order[n]])]++;
+    }
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        if (table->band_last[band] > table->band_max[band]) {
+            table->band_max[band] = table->band_last[band];
+        }
+        table->band_total[band] += table->band_last[band];
+    }
+
+    /* OAM was copied over as the last frame was drawn if it was multiplexed,
+     * and all of it changes if this one is */
+    int copied_over = table->multiplexed;
+    table->multiplexed = shown > OAM_ENTRIES;
+    table->mux.active[table->mux.back] = table->multiplexed;
+
+    if (table->multiplexed) {
+        shown = sprite_mux_pack(table, order, shown);
+        table->mux_frames++;
+    } else {
+        for (int entry = 0; entry < shown; entry++) {
+            int i = order[entry];
+
+            /* one which hasn't changed and stays in the same entry is already there */
+            if (table->oam_entry[i] != entry || (table->dirty[i >> 5] & (1u << (i & 31)))) {
+                sprite_pack_entry(table, entry, &table->sprites[i]);
+                table->oam_entry[i] = entry;
+            }
+        }
+
+        for (int entry = shown; entry < table->shown; entry++) {
+            sprite_pack_entry(table, entry, &sprite_hidden);
+        }
+    }
+
+    if (copied_over || table->multiplexed) {
+        for (int word = 0; word < OAM_ENTRIES / 32; word++) {
+            table->oam_dirty[word] = 0xffffffff;
+        }
+    }
+
+    for (int word = 0; word < NUM_SPRITES / 32 + 1; word++) {
+        table->dirty[word] = 0;
+    }
+
+    table->shown = table->multiplexed ? OAM_ENTRIES : shown;
+    if (shown > table->shown_max) {
+        table->shown_max = shown;
+    }
+    table->shown_total += shown;
+}
+
+/* pack the sprites, and queue up all of the entries of OAM which have changed */
+void sprite_update_all(struct SpriteTable* table, struct DmaQueue* queue) {
+    sprite_pack(table);
+    table->oam_bytes_last = 0;
+
+    /* the start of the run of changed entries we are in, or -1 if none */
+    int first = -1;
+
+    for (int word = 0; word < OAM_ENTRIES / 32; word++) {
+        unsigned int dirty = table->oam_dirty[word];
+        table->oam_dirty[word] = 0;
+
+        /* jump between the edges of each run of changed entries, copying each
+         * run with one transfer */
+        int bit = 0;
+        while (bit < 32) {
+            if (first < 0) {
+                /* find where the next run starts */
+                unsigned int rest = dirty >> bit;
+                if (rest == 0) {
+                    break;
+                }
+                bit += __builtin_ctz(rest);
+                first = word * 32 + bit;
+            } else {
+                /* find where this run ends, it may carry on into the next word */
+                unsigned int rest = ~dirty >> bit;
+                if (rest == 0) {
+                    break;
+                }
+                bit += __builtin_ctz(rest);
+                sprite_flush(table, queue, first, word * 32 + bit);
+                first = -1;
+            }
+        }
+    }
+
+    /* a run can go right up to the last entry */
+    if (first >= 0) {
+        sprite_flush(table, queue, first, OAM_ENTRIES);
+    }
+
+    table->oam_bytes_total += table->oam_bytes_last;
+}
+
+/* the sprites of the frame being drawn, for the vcount interrupt */
+struct SpriteTable* sprite_mux_table = 0;
+
+/* the lines the copy of a band's half of OAM starts and stops at - each line's
+ * sprites are worked out while the line before is drawn, so it stops a line
+ * before that, and the half's last band is finished just before it starts */
+static int sprite_mux_start(int band) {
+    return band * SPRITE_BAND_HEIGHT - SPRITE_MUX_HEIGHT - 2;
+}
+
+static int sprite_mux_stop(int band) {
+    return band * SPRITE_BAND_HEIGHT - 2;
+}
+
+/* run by the vcount interrupt while a multiplexed frame is drawn, to start
+ * copying the next band into its half of OAM a few entries each hblank, or to
+ * stop once it has all been copied and wait for the band after */
+void sprite_mux_line() {
+    struct SpriteMux* mux = &sprite_mux_table->mux;
+    int line;
+    if (!mux->copying) {
+        dma_hblank_start(DMA_HBLANK_SPRITES,
+                sprite_attribute_memory + (mux->band & 1) * SPRITE_BAND_ENTRIES * 4,
+                mux->bands[mux->front][mux->band - 2],
+                SPRITE_BAND_ENTRIES / SPRITE_MUX_HEIGHT * sizeof(struct Sprite) / 4);
+        mux->copying = 1;
+        line = sprite_mux_stop(mux->band);
+    } else {
+        dma_hblank_stop(DMA_HBLANK_SPRITES);
+        mux->copying = 0;
+        if (++mux->band == SPRITE_BANDS) {
+            *interrupt_enable &= ~INTERRUPT_VCOUNT;
+            return;
+        }
+        line = sprite_mux_start(mux->band);
+    }
+    *display_status = (*display_status & 0xff) | DISPLAY_VCOUNT(line);
+}
+
+/* show the sprites packed for the frame about to be drawn, this must be called
+ * during vblank - if they are multiplexed, the vcount interrupt copies in each
+ * band after the first two as the screen is drawn */
+void sprite_mux_show(struct SpriteTable* table) {
+    struct SpriteMux* mux = &table->mux;
+    dma_hblank_stop(DMA_HBLANK_SPRITES);
+    mux->front = mux->back;
+    mux->back ^= 1;
+
+    if (!mux->active[mux->front]) {
+        *display_control &= ~DISPLAY_HBLANK_OAM;
+        *display_status &= ~DISPLAY_VCOUNT_INTERRUPT;
+        *interrupt_enable &= ~INTERRUPT_VCOUNT;
+        return;
+    }
+
+    sprite_mux_table = table;
+    mux->band = 2;
+    mux->copying = 0;
+#ifdef HOST
+    host_vcount_handler = sprite_mux_line;
+#endif
+    *display_control |= DISPLAY_HBLANK_OAM;
+    *display_status = (*display_status & 0xff) | DISPLAY_VCOUNT_INTERRUPT |
+        DISPLAY_VCOUNT(sprite_mux_start(mux->band));
+    *interrupt_enable |= INTERRUPT_VCOUNT;
 }
 
 /* setup all sprites */
-void sprite_clear() {
+void sprite_clear(struct SpriteTable* table) {
     /* clear the index counter */
-    next_sprite_index = 0;
+    table->next = 0;
 
-    /* move all sprites offscreen to hide them */
-    for(int i = 0; i < NUM_SPRITES; i++) {
-        sprites[i].attribute0 = SCREEN_HEIGHT;
-        sprites[i].attribute1 = SCREEN_WIDTH;
+    /* disable every entry of OAM, they all need to be copied */
+    for (int i = 0; i < NUM_SPRITES + 1; i++) {
+        table->sprites[i].attribute0 = SPRITE_HIDDEN;
+        table->sprites[i].attribute1 = 0;
+        table->sprites[i].attribute2 = 0;
+    }
+    for (int i = 0; i < NUM_SPRITES; i++) {
+        table->oam_entry[i] = SPRITE_NOT_SHOWN;
     }
+    for (int i = 0; i < OAM_ENTRIES; i++) {
+        table->oam[i] = sprite_hidden;
+    }
+    for (int i = 0; i < NUM_SPRITES / 32 + 1; i++) {
+        table->dirty[i] = 0;
+    }
+    for (int i = 0; i < OAM_ENTRIES / 32; i++) {
+        table->oam_dirty[i] = 0xffffffff;
+    }
+    table->shown = 0;
+    table->depth_sort = 1;
 }
 
-/* set a sprite postion */
-void sprite_position(struct Sprite* sprite, int x, int y) {
-    /* clear out the y coordinate */
-    sprite->attribute0 &= 0xff00;
+/* move a sprite to another layer */
+void sprite_set_layer(struct SpriteTable* table, struct Sprite* sprite, int layer) {
+    table->layer[sprite - table->sprites] = layer;
+}
 
-    /* set the new y coordinate */
-    sprite->attribute0 |= (y & 0xff);
+/* hide a sprite or show it again, a hidden one is left out of OAM */
+void sprite_set_visible(struct SpriteTable* table, struct Sprite* sprite, int visible) {
+    unsigned short attribute0;
+    if (visible) {
+        attribute0 = sprite->attribute0 & ~SPRITE_HIDDEN;
+    } else {
+        attribute0 = sprite->attribute0 | SPRITE_HIDDEN;
+    }
 
-    /* clear out the x coordinate */
-    sprite->attribute1 &= 0xfe00;
+    if (attribute0 != sprite->attribute0) {
+        sprite->attribute0 = attribute0;
+        sprite_mark_dirty(table, sprite);
+    }
+}
 
-    /* set the new x coordinate */
-    sprite->attribute1 |= (x & 0x1ff);
+/* set a sprite postion */
+void sprite_position(struct SpriteTable* table, struct Sprite* sprite, int x, int y) {
+    /* clear out the y coordinate and set the new one */
+    unsigned short attribute0 = (sprite->attribute0 & 0xff00) | (y & 0xff);
+
+    /* clear out the x coordinate and set the new one */
+    unsigned short attribute1 = (sprite->attribute1 & 0xfe00) | (x & 0x1ff);
+
+    /* only a sprite which actually moved needs copying */
+    if (attribute0 != sprite->attribute0 || attribute1 != sprite->attribute1) {
+        sprite->attribute0 = attribute0;
+        sprite->attribute1 = attribute1;
+        sprite_mark_dirty(table, sprite);
+    }
 }
 
 /* move a sprite in a direction */
-void sprite_move(struct Sprite* sprite, int dx, int dy) {
+void sprite_move(struct SpriteTable* table, struct Sprite* sprite, int dx, int dy) {
     /* get the current y coordinate */
     int y = sprite->attribute0 & 0xff;
 
@@ -282,652 +700,770 @@ void sprite_move(struct Sprite* sprite, int dx, int dy) {
     int x = sprite->attribute1 & 0x1ff;
 
     /* move to the new location */
-    sprite_position(sprite, x + dx, y + dy);
+    sprite_position(table, sprite, x + dx, y + dy);
 }
 
 /* change the vertical flip flag */
-void sprite_set_vertical_flip(struct Sprite* sprite, int vertical_flip) {
+void sprite_set_vertical_flip(struct SpriteTable* table, struct Sprite* sprite, int vertical_flip) {
+    unsigned short attribute1;
     if (vertical_flip) {
         /* set the bit */
-        sprite->attribute1 |= 0x2000;
+        attribute1 = sprite->attribute1 | 0x2000;
     } else {
         /* clear the bit */
-        sprite->attribute1 &= 0xdfff;
+        attribute1 = sprite->attribute1 & 0xdfff;
+    }
+
+    if (attribute1 != sprite->attribute1) {
+        sprite->attribute1 = attribute1;
+        sprite_mark_dirty(table, sprite);
     }
 }
 
 /* change the horizontal flip flag */
-void sprite_set_horizontal_flip(struct Sprite* sprite, int horizontal_flip) {
+void sprite_set_horizontal_flip(struct SpriteTable* table, struct Sprite* sprite, int horizontal_flip) {
+    unsigned short attribute1;
     if (horizontal_flip) {
         /* set the bit */
-        sprite->attribute1 |= 0x1000;
+        attribute1 = sprite->attribute1 | 0x1000;
     } else {
         /* clear the bit */
-        sprite->attribute1 &= 0xefff;
+        attribute1 = sprite->attribute1 & 0xefff;
+    }
+
+    if (attribute1 != sprite->attribute1) {
+        sprite->attribute1 = attribute1;
+        sprite_mark_dirty(table, sprite);
     }
 }
 
 /* change the tile offset of a sprite */
-void sprite_set_offset(struct Sprite* sprite, int offset) {
-    /* clear the old offset */
-    sprite->attribute2 &= 0xfc00;
+void sprite_set_offset(struct SpriteTable* table, struct Sprite* sprite, int offset) {
+    /* clear the old offset and apply the new one */
+    unsigned short attribute2 = (sprite->attribute2 & 0xfc00) | (offset & 0x03ff);
 
-    /* apply the new one */
-    sprite->attribute2 |= (offset & 0x03ff);
+    if (attribute2 != sprite->attribute2) {
+        sprite->attribute2 = attribute2;
+        sprite_mark_dirty(table, sprite);
+    }
 }
 
-/* setup the sprite image and palette */
-void setup_sprite_image() {
-    /* load the palette from the image into palette memory*/
-    memcpy16_dma((unsigned short*) sprite_palette, (unsigned short*) Sprites_palette, PALETTE_SIZE);
+/* change the palette bank a 16 color sprite uses */
+void sprite_set_palette(struct SpriteTable* table, struct Sprite* sprite, int bank) {
+    unsigned short attribute2 = (sprite->attribute2 & 0x0fff) | ((bank & 0xf) << 12);
 
-    /* load the image into sprite image memory */
-    memcpy16_dma((unsigned short*) sprite_image_memory, (unsigned short*) Sprites_data, (Sprites_width * Sprites_height) / 2);
+    if (attribute2 != sprite->attribute2) {
+        sprite->attribute2 = attribute2;
+        sprite_mark_dirty(table, sprite);
+    }
 }
 
-/* a struct for the koopa's logic and behavior */
-struct Player {
-    /* the actual sprite attribute info */
-    struct Sprite* sprite;
-
-    /* the x and y postion in pixels */
-    int x, y;
-
-    /* the koopa's y velocity in 1/256 pixels/second */
-    //int yvel;
+/* set the flips and palette bank of an animated sprite from its frame */
+void sprite_show_frame(struct SpriteTable* table, struct Animation* animation) {
+    const struct AnimFrame* frame = anim_frame(animation);
+    sprite_set_horizontal_flip(table, animation->sprite, frame->flags & ANIM_FLIP_H);
+    sprite_set_vertical_flip(table, animation->sprite, frame->flags & ANIM_FLIP_V);
+    sprite_set_palette(table, animation->sprite, asset_sprite_banks[frame->tile]);
+    animation->changed = 0;
+}
 
-    /* the koopa's y acceleration in 1/256 pixels/second^2 */
-    //int gravity; 
+/* make a sprite which plays a clip, its tiles are filled in at the next vblank -
+ * if there is no room for it, it gets the spare animation and the spare sprite,
+ * neither of which is ever shown */
+struct Animation* sprite_animate(struct Game* game, int x, int y, enum SpriteSize size,
+        int tiles, const struct AnimClip* clip, int priority) {
+    struct Animation* animation = anim_add(&game->animator, tiles, clip);
+    if (!animation) {
+        animation = anim_spare(&game->animator, clip);
+        animation->sprite = &game->sprite_table.sprites[NUM_SPRITES];
+        return animation;
+    }
+    animation->sprite = sprite_init(&game->sprite_table, x, y, size, 0, 0, animation->slot,
+            priority);
+    sprite_show_frame(&game->sprite_table, animation);
+    return animation;
+}
 
-    /* which frame of the animation he is on */
-    int frame;
+/* update the sprites whose animation frame changed */
+void animations_update(struct Game* game) {
+    struct Animator* animator = &game->animator;
 
-    /* the number of frames to wait before flipping */
-    int animation_delay;
-    
-    int animation_state;
+    for (int i = 0; i < animator->count; i++) {
+        if (animator->animations[i].changed) {
+            sprite_show_frame(&game->sprite_table, &animator->animations[i]);
+        }
+    }
+}
 
-    /* the animation counter counts how many frames until we flip */
-    int counter;
+/* setup the sprite palette - the images are copied in a frame at a time as
+ * the sprites are animated */
+void setup_sprite_image() {
+    /* unpack the palette from the image into palette memory*/
+    asset_load(sprite_palette, asset_sprite_palette);
+}
 
-    /* whether the player is moving right now or not */
-    int move;
-    
-    int facing;
+/* the tiles in a 16x16 and an 8x8 sprite */
+#define SPRITE_TILES_16_16 4
+#define SPRITE_TILES_8_8 1
+
+/* the player, bullets and slimes each keep an animation for the whole game */
+#if 1 + MAX_BULLETS + MAX_SLIMES > MAX_ANIMATIONS
+#error "there aren't enough animations for every sprite the game makes"
+#endif
+#if (1 + MAX_SLIMES) * SPRITE_TILES_16_16 + MAX_BULLETS * SPRITE_TILES_8_8 > ANIM_VRAM_TILES
+#error "there isn't enough sprite VRAM for every sprite the game makes"
+#endif
+
+/* the player standing and walking in each way it can face - down, left, right
+ * and up - where left is the right facing frames flipped */
+#define PLAYER_WALK_DELAY 8
+
+const struct AnimFrame player_stand_down_frames[] = {{0, 0, 0}};
+const struct AnimFrame player_stand_left_frames[] = {{12, 0, ANIM_FLIP_H}};
+const struct AnimFrame player_stand_right_frames[] = {{12, 0, 0}};
+const struct AnimFrame player_stand_up_frames[] = {{20, 0, 0}};
+
+const struct AnimFrame player_walk_down_frames[] = {
+    {4, PLAYER_WALK_DELAY, 0}, {8, PLAYER_WALK_DELAY, 0}
+};
+const struct AnimFrame player_walk_left_frames[] = {
+    {12, PLAYER_WALK_DELAY, ANIM_FLIP_H}, {16, PLAYER_WALK_DELAY, ANIM_FLIP_H}
+};
+const struct AnimFrame player_walk_right_frames[] = {
+    {12, PLAYER_WALK_DELAY, 0}, {16, PLAYER_WALK_DELAY, 0}
+};
+const struct AnimFrame player_walk_up_frames[] = {
+    {24, PLAYER_WALK_DELAY, 0}, {28, PLAYER_WALK_DELAY, 0}
+};
 
-    /* the number of pixels away from the edge of the screen the player stays */
-    int border;
+/* indexed by the way the player is facing */
+const struct AnimClip player_stand[4] = {
+    ANIM_CLIP(player_stand_down_frames),
+    ANIM_CLIP(player_stand_left_frames),
+    ANIM_CLIP(player_stand_right_frames),
+    ANIM_CLIP(player_stand_up_frames)
+};
 
-    int health;
-    
-    int invincible;
+const struct AnimClip player_walk[4] = {
+    ANIM_CLIP(player_walk_down_frames),
+    ANIM_CLIP(player_walk_left_frames),
+    ANIM_CLIP(player_walk_right_frames),
+    ANIM_CLIP(player_walk_up_frames)
 };
 
-/* initialize the player */
-void player_init(struct Player* player) {
-    player->x = 100;
-    player->y = 113;
+/* the ways the player can face */
+#define FACING_DOWN 0
+#define FACING_LEFT 1
+#define FACING_RIGHT 2
+#define FACING_UP 3
+
+/* initialize the player, at the same place on the screen wherever the camera is */
+void player_init(struct Game* game) {
+    struct Player* player = &game->player;
+    player->x = FIXED(game->camera.x + 100);
+    player->y = FIXED(game->camera.y + 113);
+    player->vx = 0;
+    player->vy = 0;
+    player->ax = 0;
+    player->ay = 0;
     player->border = 40;
-    player->frame = 0;
-    player->move = 0;
-    player->counter = 0;
-    player->animation_delay = 8;
-    player->animation_state = 0;
-    player->facing = 0;
+    player->facing = FACING_DOWN;
     player->health = 3;
-    player->invincible = 0;
-    player->sprite = sprite_init(player->x, player->y, SIZE_16_16, 0, 0, player->frame, 1);
+    timer_init(&player->invincible, 0, 0);
+    player->animation = sprite_animate(game, 100, 113, SIZE_16_16, SPRITE_TILES_16_16,
+            &player_stand[player->facing], 1);
+    player->sprite = player->animation->sprite;
 }
 
-struct Bullet {
-    /* the actual sprite attribute info */
-    struct Sprite* sprite;
+/* empty out a pool which can hold up to capacity entities */
+void pool_init(struct Pool* pool, int capacity) {
+    pool->capacity = capacity;
+    pool->count = 0;
 
-    /* the x and y postion in pixels */
-    int x, y;
-    
-    int dx, dy;
-    
-    int transparent;
-};
+    /* chain every slot onto the free list */
+    for (int i = 0; i < capacity; i++) {
+        pool->next_free[i] = (i + 1 < capacity) ? i + 1 : NO_SLOT;
+    }
+    pool->free_head = capacity > 0 ? 0 : NO_SLOT;
+}
+
+/* take a slot from the free list, returns -1 if the pool is full */
+int pool_spawn(struct Pool* pool) {
+    int slot = pool->free_head;
+    if (slot == NO_SLOT) {
+        return -1;
+    }
+    pool->free_head = pool->next_free[slot];
 
-void bullet_init(struct Bullet* bullet) {
-    bullet->x = 0;
-    bullet->y = 0;
-    bullet->dx = 0;
-    bullet->dy = 0;
-    bullet->transparent = 1;
-    bullet->sprite = sprite_init(bullet->x, bullet->y, SIZE_8_8, 0, 0, 90, 1);
+    /* add it to the end of the live ones */
+    pool->where[slot] = pool->count;
+    pool->live[pool->count++] = slot;
+    return slot;
 }
 
-struct Slime{
-     /* the actual sprite attribute info */
-    struct Sprite* sprite;
+/* give a slot back to the free list */
+void pool_despawn(struct Pool* pool, int slot) {
+    /* move the last live slot into the hole this one leaves */
+    int last = pool->live[--pool->count];
+    pool->live[pool->where[slot]] = last;
+    pool->where[last] = pool->where[slot];
 
-    /* the x and y postion in pixels */
-    int x, y;
-    
-    int health;
-    
-    int frame;
-    
-    int animation_delay;
-    
-    int animation_state;
-    
-    int wait;
-    
-    int dead;
-    
-    int delay;
-    
-    int id;
-};
+    pool->next_free[slot] = pool->free_head;
+    pool->free_head = slot;
+}
 
-void slime_init(struct Slime* slime, int id, int delay){
-    slime->x = 240;
-    slime->y = 240;
-    slime->health = 1;
-    slime->frame = 64;
-    slime->animation_delay = 8;
-    slime->animation_state = 0;
-    slime->wait = 6;
-    slime->dead = 0;
-    slime->delay = delay;
-    slime->id = id;
-    slime->sprite = sprite_init(slime->x, slime->y, SIZE_16_16, 0, 0, slime->frame, 2);
+/* a bullet, and the blank tile shown while a bullet slot is free */
+const struct AnimFrame bullet_frames[] = {{44, 0, 0}};
+const struct AnimClip bullet_clip = ANIM_CLIP(bullet_frames);
+
+void bullets_init(struct Game* game) {
+    struct Bullets* bullets = &game->bullets;
+    pool_init(&bullets->pool, MAX_BULLETS);
+
+    /* each slot keeps its own sprite, which is hidden while it is free */
+    for (int i = 0; i < MAX_BULLETS; i++) {
+        bullets->x[i] = 0;
+        bullets->y[i] = 0;
+        bullets->vx[i] = 0;
+        bullets->vy[i] = 0;
+        bullets->animation[i] = sprite_animate(game, 0, 0, SIZE_8_8, SPRITE_TILES_8_8,
+                &bullet_clip, 1);
+        bullets->sprite[i] = bullets->animation[i]->sprite;
+        sprite_set_visible(&game->sprite_table, bullets->sprite[i], 0);
+
+        /* bullets fly over everything else */
+        sprite_set_layer(&game->sprite_table, bullets->sprite[i], 1);
+    }
 }
-    
-    
 
-/* finds which tile a screen coordinate maps to, taking scroll into acco  unt */
-unsigned short tile_lookup(int x, int y, int xscroll, int yscroll,
-        const unsigned short* tilemap, int tilemap_w, int tilemap_h) {
+/* take a bullet out of play */
+void bullet_despawn(struct Bullets* bullets, int i, struct SpriteTable* table) {
+    bullets->x[i] = 0;
+    bullets->y[i] = 0;
+    bullets->vx[i] = 0;
+    bullets->vy[i] = 0;
+    sprite_set_visible(table, bullets->sprite[i], 0);
+    pool_despawn(&bullets->pool, i);
+}
 
-    /* adjust for the scroll */
-    x += xscroll;
-    y += yscroll;
+/* where a slime appears */
+struct SlimeSpawn {
+    short x, y;
+};
 
-    /* convert from screen coordinates to tile coordinates */
-    x >>= 3;
-    y >>= 3;
+/* the spawn points, top, bottom, left and right */
+const struct SlimeSpawn slime_spawns[] = {
+    {120, 0},
+    {120, 144},
+    {16, 80},
+    {224, 80}
+};
 
-    /* account for wraparound */
-    while (x >= tilemap_w) {
-        x -= tilemap_w;
-    }
-    while (y >= tilemap_h) {
-        y -= tilemap_h;
-    }
-    while (x < 0) {
-        x += tilemap_w;
-    }
-    while (y < 0) {
-        y += tilemap_h;
-    }
+/* the slimes which come out as each wave starts, on top of the ones coming
+ * back after being killed - the first wave is the game's first four slimes,
+ * and a wave which isn't here adds nothing */
+const struct SpawnEntry slime_wave1[] = {
+    {100, 0}, {400, 1}, {800, 2}, {1000, 3}
+};
+const struct SpawnEntry slime_wave3[] = {
+    {60, 2}, {120, 3}
+};
+const struct SpawnEntry slime_wave5[] = {
+    {30, 0}, {60, 1}, {90, 2}, {120, 3}
+};
+const struct SpawnEntry slime_wave8[] = {
+    {20, 0}, {40, 1}, {60, 2}, {80, 3}, {100, 0}, {120, 1},
+    {140, 2}, {160, 3}, {180, 0}, {200, 1}, {220, 2}, {240, 3},
+    {300, 0}, {320, 1}, {340, 2}, {360, 3}, {380, 0}, {400, 1},
+    {420, 2}, {440, 3}, {460, 0}, {480, 1}, {500, 2}, {520, 3}
+};
 
-    /* the larger screen maps (bigger than 32x32) are made of multiple stitched
-       together - the offset is used for finding which screen block we are in
-       for these cases */
-    int offset = 0;
+const struct SpawnWave slime_waves[] = {
+    SPAWN_WAVE(1, slime_wave1),
+    SPAWN_WAVE(3, slime_wave3),
+    SPAWN_WAVE(5, slime_wave5),
+    SPAWN_WAVE(8, slime_wave8)
+};
 
-    /* if the width is 64, add 0x400 offset to get to tile maps on right   */
-    if (tilemap_w == 64 && x >= 32) {
-        x -= 32;
-        offset += 0x400;
-    }
+#define NUM_SLIME_WAVES ((int) (sizeof(slime_waves) / sizeof(slime_waves[0])))
 
-    /* if height is 64 and were down there */
-    if (tilemap_h == 64 && y >= 32) {
-        y -= 32;
+/* slimes only have the one frame */
+const struct AnimFrame slime_frames[] = {{32, 0, 0}};
+const struct AnimClip slime_clip = ANIM_CLIP(slime_frames);
 
-        /* if width is also 64 add 0x800, else just 0x400 */
-        if (tilemap_w == 64) {
-            offset += 0x800;
-        } else {
-            offset += 0x400;
-        }
-    }
+/* the frames a slime stays away after being killed */
+#define SLIME_RESPAWN_DELAY 500
 
-    /* find the index in this tile map */
-    int index = y * 32 + x;
+/* the frames a spawn waits to try again when every slime is already out */
+#define SLIME_RETRY_DELAY 30
 
-    /* return the tile */
-    return tilemap[index + offset];
-}
+void slimes_init(struct Game* game) {
+    struct Slimes* slimes = &game->slimes;
+    pool_init(&slimes->pool, MAX_SLIMES);
 
-/* move the player left, right, up, or down. returns if it is at edge of the screen */
-int player_left(struct Player* player, int xscroll, int yscroll) {
-    /* face left */
-    sprite_set_horizontal_flip(player->sprite, 1);
-    player->move = 1;
-    player->facing = 1;
-    unsigned short tile = tile_lookup(player->x, player->y+1, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-        return 0; 
-    }
-    
-    unsigned short tile2 = tile_lookup(player->x, player->y+15, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-        return 0; 
-    }
-    
-    /* if we are at the left end, just scroll the screen */
-    if (player->x < player->border) {
-        return 1;
-    } else {
-        /* else move left */
-        player->x--;
-        return 0;
+    /* each slot keeps its own sprite, which is hidden while it is free */
+    for (int i = 0; i < MAX_SLIMES; i++) {
+        slimes->sprite[i] = sprite_animate(game, 0, 0, SIZE_16_16, SPRITE_TILES_16_16,
+                &slime_clip, 2)->sprite;
+        sprite_set_visible(&game->sprite_table, slimes->sprite[i], 0);
     }
+
+    /* nothing is out until the first wave starts */
+    spawn_queue_clear(&slimes->spawns);
 }
 
-int player_right(struct Player* player, int xscroll, int yscroll) {
-    /* face right */
-    sprite_set_horizontal_flip(player->sprite, 0);
-    player->move = 1;
-    player->facing = 2;
-    
-    unsigned short tile = tile_lookup(player->x+16, player->y+1, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-        return 0; 
-    }
-    
-    unsigned short tile2 = tile_lookup(player->x+16, player->y+15, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-        return 0; 
+/* queue up the slimes which come out when a wave starts */
+void slimes_wave(struct Slimes* slimes, int wave) {
+    for (int w = 0; w < NUM_SLIME_WAVES; w++) {
+        if (slime_waves[w].wave == wave) {
+            spawn_queue_wave(&slimes->spawns, &slime_waves[w]);
+        }
     }
+}
 
-    /* if we are at the right end, just scroll the screen */
-    if (player->x > (SCREEN_WIDTH - 16 - player->border)) {
-        return 1;
-    } else {
-        /* else move right */
-        player->x++;
-        return 0;
+/* bring a slime out at a spawn point, which is a place on the screen wherever
+ * the camera is, or try again later if they are all out */
+void slime_spawn(struct Slimes* slimes, int point, const struct Camera* camera) {
+    int i = pool_spawn(&slimes->pool);
+    if (i < 0) {
+        spawn_queue_add(&slimes->spawns, SLIME_RETRY_DELAY, point);
+        return;
     }
+
+    slimes->x[i] = FIXED(camera->x + slime_spawns[point].x);
+    slimes->y[i] = FIXED(camera->y + slime_spawns[point].y);
+    slimes->vx[i] = 0;
+    slimes->vy[i] = 0;
+    slimes->flags[i] = 0;
+    slimes->spawn[i] = point;
 }
 
-int player_up(struct Player* player, int xscroll, int yscroll) {
-    /* face right */
-    sprite_set_horizontal_flip(player->sprite, 0);
-    player->move = 2;
-    player->facing = 3;
-    
-    unsigned short tile = tile_lookup(player->x+1, player->y, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-        return 0; 
-    }
-    
-    unsigned short tile2 = tile_lookup(player->x+15, player->y, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-        return 0; 
-    }
+/* take a killed slime out, and have it come back at its spawn point later */
+void slime_despawn(struct Slimes* slimes, int i, struct SpriteTable* table) {
+    sprite_set_visible(table, slimes->sprite[i], 0);
+    pool_despawn(&slimes->pool, i);
+    spawn_queue_add(&slimes->spawns, SLIME_RESPAWN_DELAY, slimes->spawn[i]);
+}
 
-    /* if we are at the right end, just scroll the screen */
-    if (player->y < player->border) {
-        return 1;
+/* check the edge a 16x16 sprite at (x, y) in the world is about to step into,
+ * one of dx and dy is -1 or 1 to pick the edge */
+int edge_blocked(int x, int y, int dx, int dy) {
+    /* the edge is the 15 pixels along the side just past the sprite */
+    if (dx < 0) {
+        return map_blocked(&background_collision, x, y + 1, 1, 15);
+    } else if (dx > 0) {
+        return map_blocked(&background_collision, x + 16, y + 1, 1, 15);
+    } else if (dy < 0) {
+        return map_blocked(&background_collision, x + 1, y, 15, 1);
     } else {
-        /* else move right */
-        player->y--;
-        return 0;
+        return map_blocked(&background_collision, x + 1, y + 16, 15, 1);
     }
 }
 
-int player_down(struct Player* player, int xscroll, int yscroll) {
-    /* face right */
-    sprite_set_horizontal_flip(player->sprite, 0);
-    player->move = 3;
-    player->facing = 0;
-    
-    unsigned short tile = tile_lookup(player->x+1, player->y+16, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-        return 0; 
-    }
-    
-    unsigned short tile2 = tile_lookup(player->x+15, player->y+16, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-        return 0; 
-    }
+/* how hard the arrow keys push the player, and the part of its speed it keeps
+ * each frame - together these top out just under a pixel a frame */
+#define PLAYER_ACCELERATION 86
+#define PLAYER_FRICTION 192
+
+/* push the player one way, walking that way */
+void player_walk_to(struct Player* player, int facing, int ax, int ay) {
+    player->facing = facing;
+    player->ax = ax;
+    player->ay = ay;
+    anim_play(player->animation, &player_walk[facing]);
+}
 
-    /* if we are at the right end, just scroll the screen */
-    if (player->y > (SCREEN_HEIGHT - 16 - player->border)) {
-        return 1;
-    } else {
-        /* else move right */
-        player->y++;
-        return 0;
-    }
+/* push the player left, right, up, or down */
+void player_left(struct Player* player) {
+    player_walk_to(player, FACING_LEFT, -PLAYER_ACCELERATION, 0);
 }
 
-/* stop the player from walking */
+void player_right(struct Player* player) {
+    player_walk_to(player, FACING_RIGHT, PLAYER_ACCELERATION, 0);
+}
+
+void player_up(struct Player* player) {
+    player_walk_to(player, FACING_UP, 0, -PLAYER_ACCELERATION);
+}
+
+void player_down(struct Player* player) {
+    player_walk_to(player, FACING_DOWN, 0, PLAYER_ACCELERATION);
+}
+
+/* stop the player from walking, standing the way it faces */
 void player_stop(struct Player* player) {
-    player->move = 0;
-    if (player->facing == 0){
-    	player->frame = 0;
-    }
-    if (player->facing == 1 || player->facing == 2){
-    	player->frame = 24;
-    }
-    if (player->facing == 3){
-    	player->frame = 40;
-    }	
-    player->counter = 7;
-    sprite_set_offset(player->sprite, player->frame);
+    player->ax = 0;
+    player->ay = 0;
+    anim_play(player->animation, &player_stand[player->facing]);
 }
 
+/* the frames between shots */
+#define BULLET_DELAY 20
 
-void shoot(struct Player* player, struct Bullet* bullet){
-    bullet->x = player->x+8;
-    bullet->y = player->y+8;
-    if (player->facing == 0) {
-    	bullet->dy = 1;
+/* fire a bullet from the player, if one is free */
+void shoot(struct Player* player, struct Bullets* bullets){
+    int i = pool_spawn(&bullets->pool);
+    if (i < 0) {
+        return;
+    }
+
+    bullets->x[i] = player->x+FIXED(8);
+    bullets->y[i] = player->y+FIXED(8);
+    if (player->facing == FACING_DOWN) {
+    	bullets->vy[i] = FIXED_ONE;
     }
     
-    if (player->facing == 1) {
-    	bullet->dx = -1;
+    if (player->facing == FACING_LEFT) {
+    	bullets->vx[i] = -FIXED_ONE;
     }
     
-    if (player->facing == 2) {
-    	bullet->dx = 1;
+    if (player->facing == FACING_RIGHT) {
+    	bullets->vx[i] = FIXED_ONE;
     }
     
-    if (player->facing == 3) {
-    	bullet->dy = -1;
+    if (player->facing == FACING_UP) {
+    	bullets->vy[i] = -FIXED_ONE;
     }	
-    sprite_set_offset(bullet->sprite, 88);
-    bullet->transparent = 0;
+    anim_play(bullets->animation[i], &bullet_clip);
 }
 
-void slime_move(struct Slime* slime, struct Player* player, int xscroll, int yscroll, int wave){
-    if (slime->wait > 0){
-    	slime->wait--;
-    	return;
-    }
-
-    if (player->x > slime->x){
-    	if (player->y > slime->y && player->y - slime->y > player->x - slime->x){
-    	    unsigned short tile = tile_lookup(slime->x+1, slime->y+16, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-    	    unsigned short tile2 = tile_lookup(player->x+15, player->y+16, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->y++;
-    	} else if (player->y < slime->y && slime->y - player->y > player->x - slime->x){
-    	    unsigned short tile = tile_lookup(slime->x+1, slime->y, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-    	    unsigned short tile2 = tile_lookup(player->x+15, player->y, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->y--;
+/* how fast slimes go on the first wave, and how much faster each wave makes them,
+ * in 1/256 pixels/frame */
+#define SLIME_SPEED 36
+#define SLIME_SPEED_PER_WAVE 8
+
+/* set a slime's velocity towards the player */
+void slime_move(struct Slimes* slimes, int i, struct Player* player, const struct FlowField* flow, int speed){
+    int sx = FIXED_PIXELS(slimes->x[i]);
+    int sy = FIXED_PIXELS(slimes->y[i]);
+    int px = FIXED_PIXELS(player->x);
+    int py = FIXED_PIXELS(player->y);
+
+    /* the tile nearest the slime's corner on the map */
+    int tx = (sx + 4) >> 3;
+    int ty = (sy + 4) >> 3;
+
+    int dx = 0, dy = 0;
+    if (flow_direction(flow, tx, ty, &dx, &dy)) {
+        /* follow the field, but line up with the row or column of tiles before
+         * turning so the slime fits through the gap the path goes through */
+        int ax = tx * 8;
+        int ay = ty * 8;
+        if (dx != 0 && sy != ay) {
+            dx = 0;
+            dy = (ay > sy) ? 1 : -1;
+        } else if (dy != 0 && sx != ax) {
+            dy = 0;
+            dx = (ax > sx) ? 1 : -1;
+        }
+    } else if (px > sx){
+        /* off the field, just step along whichever way the player is furthest */
+    	if (py > sy && py - sy > px - sx){
+    	    dy = 1;
+    	} else if (py < sy && sy - py > px - sx){
+    	    dy = -1;
     	} else {
-    	
-    	    unsigned short tile = tile_lookup(slime->x+16, slime->y+1, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-	    unsigned short tile2 = tile_lookup(player->x+16, player->y+15, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->x++;
+    	    dx = 1;
     	}
-    } else if (player->x < slime->x){
-        if (player->y > slime->y && player->y - slime->y > slime->x - player->x){
-    	    unsigned short tile = tile_lookup(slime->x+1, slime->y+16, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-    	    unsigned short tile2 = tile_lookup(player->x+15, player->y+16, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->y++;
-    	} else if (player->y < slime->y && slime->y - player->y > slime->x - player->x){
-    	    unsigned short tile = tile_lookup(slime->x+1, slime->y, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-    	    unsigned short tile2 = tile_lookup(player->x+15, player->y, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->y--;
+    } else if (px < sx){
+        if (py > sy && py - sy > sx - px){
+    	    dy = 1;
+    	} else if (py < sy && sy - py > sx - px){
+    	    dy = -1;
     	} else {
-    	
-    	    unsigned short tile = tile_lookup(slime->x, slime->y+1, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-	    unsigned short tile2 = tile_lookup(player->x, player->y+15, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->x--;
+    	    dx = -1;
     	}
-    	
     } else {
-        if (player->y < slime->y){
-            unsigned short tile = tile_lookup(slime->x+1, slime->y, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-    	    unsigned short tile2 = tile_lookup(player->x+15, player->y, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->y--;
+        if (py < sy){
+    	    dy = -1;
     	} else {
-    	    unsigned short tile = tile_lookup(slime->x+1, slime->y+16, xscroll, yscroll, ForestBackground,
-            ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile == 1 || tile == 2 || tile == 5 || tile == 6){
-            	return; 
-    	    }
-    
-    	    unsigned short tile2 = tile_lookup(player->x+15, player->y+16, xscroll, yscroll, ForestBackground,
-            	ForestBackground_width, ForestBackground_height);
-    
-    	    if (tile2 == 1 || tile2 == 2 || tile2 == 5 || tile2 == 6){
-            	return; 
-    	    }
-    	    slime->y++;
+    	    dy = 1;
     	}
-    	
     }
-    slime->wait = 6-wave;
+
+    /* a wall in the way stops the slime, it tries again next frame */
+    if (edge_blocked(sx, sy, dx, dy)) {
+        dx = 0;
+        dy = 0;
+    }
+    slimes->vx[i] = dx * speed;
+    slimes->vy[i] = dy * speed;
 }
     	
-/*check if bullet hits anything */
-int bullet_check(struct Bullet* bullet, struct Slime* slime) {
-    if (bullet->x+4 > slime->x && bullet->x+4 < slime->x+16 && bullet->y+4 > slime->y && bullet->y+4 < slime->y+16 && slime->dead == 0) {
-    	bullet->x = 0;
-	bullet->y = 0;
-	bullet->dx = 0;
-	bullet->dy = 0;
-	bullet->transparent = 1;
-	sprite_set_offset(bullet->sprite, 90);
-	slime->x = 240;
-	slime->y = 240;
-	slime->dead=1;    	
-    }
-}
-
-/* update the player */
-void player_update(struct Player* player, int xscroll) {
-
-
-    /* update animation if moving */
-    if (player->move == 1) {
-        player->counter++;
-        if (player->counter >= player->animation_delay) {
-            if (player->animation_state == 0) {
-                player->frame = 24;
-                player->animation_state = 1;
-            } else {
-                player->frame = 32;
-                player->animation_state = 0;
-            }
-            sprite_set_offset(player->sprite, player->frame);
-            player->counter = 0;
-        }
+/*check if bullet hits a slime, returns 1 if it did */
+int bullet_check(struct Bullets* bullets, int b, struct Slimes* slimes, int i,
+        struct SpriteTable* table) {
+    int x = FIXED_PIXELS(bullets->x[b]) + 4;
+    int y = FIXED_PIXELS(bullets->y[b]) + 4;
+    int sx = FIXED_PIXELS(slimes->x[i]);
+    int sy = FIXED_PIXELS(slimes->y[i]);
+    if (x > sx && x < sx+16 && y > sy && y < sy+16 && !(slimes->flags[i] & SLIME_DEAD)) {
+    	bullet_despawn(bullets, b, table);
+	slimes->vx[i] = 0;
+	slimes->vy[i] = 0;
+	slimes->flags[i] |= SLIME_DEAD;
+	return 1;
     }
-    
-    if (player->move == 2) {
-        player->counter++;
-        if (player->counter >= player->animation_delay) {
-            if (player->animation_state == 0) {
-                player->frame = 48;
-                player->animation_state = 1;
-            } else {
-                player->frame = 56;
-                player->animation_state = 0;
+    return 0;
+}
+
+/* check each bullet against the slimes near it, returns the number of kills */
+int bullets_check(struct Bullets* bullets, struct Slimes* slimes, const struct Grid* grid,
+        struct SpriteTable* table) {
+    int kills = 0;
+    unsigned char nearby[GRID_MAX_ITEMS];
+
+    /* go backwards so a bullet which hits can be removed as we go */
+    for (int n = bullets->pool.count - 1; n >= 0; n--) {
+        int b = bullets->pool.live[n];
+
+        /* only the slimes in the cells around the bullet's middle can be hit */
+        int count = grid_query(grid, FIXED_PIXELS(bullets->x[b]) + 4,
+                FIXED_PIXELS(bullets->y[b]) + 4, 1, 1,
+                nearby, GRID_MAX_ITEMS);
+        for (int m = 0; m < count; m++) {
+            if (bullet_check(bullets, b, slimes, nearby[m], table)) {
+                kills++;
+                break;
             }
-            sprite_set_offset(player->sprite, player->frame);
-            player->counter = 0;
         }
     }
-    
-    if (player->move == 3) {
-        player->counter++;
-        if (player->counter >= player->animation_delay) {
-            if (player->animation_state == 0) {
-                player->frame = 8;
-                player->animation_state = 1;
-            } else {
-                player->frame = 16;
-                player->animation_state = 0;
-            }
-            sprite_set_offset(player->sprite, player->frame);
-            player->counter = 0;
+    return kills;
+}
+
+/* move all the bullets which are flying */
+void bullets_update(struct Bullets* bullets, struct SpriteTable* table,
+        const struct Camera* camera){
+    physics_move(bullets->x, bullets->y, bullets->vx, bullets->vy,
+            bullets->pool.live, bullets->pool.count);
+
+    /* take away the ones which have gone off the screen */
+    for (int n = bullets->pool.count - 1; n >= 0; n--) {
+        int i = bullets->pool.live[n];
+        int x = FIXED_PIXELS(bullets->x[i]) - camera->x;
+        int y = FIXED_PIXELS(bullets->y[i]) - camera->y;
+    	if (x > SCREEN_WIDTH || y > SCREEN_HEIGHT || x < 0 || y < 0){
+	    bullet_despawn(bullets, i, table);
+    	}
+    }
+}
+
+/* take out the slimes killed last frame, and bring out the ones which are due */
+void slimes_update(struct Slimes* slimes, struct SpriteTable* table,
+        const struct Camera* camera) {
+    /* go backwards so a dead slime can be removed as we go */
+    for (int n = slimes->pool.count - 1; n >= 0; n--) {
+        int i = slimes->pool.live[n];
+        if (slimes->flags[i] & SLIME_DEAD) {
+            slime_despawn(slimes, i, table);
         }
     }
 
-    /* set on screen position */
-    sprite_position(player->sprite, player->x, player->y);
+    spawn_queue_tick(&slimes->spawns);
+    int point;
+    while (spawn_queue_next(&slimes->spawns, &point)) {
+        slime_spawn(slimes, point, camera);
+    }
 }
 
-void update_bullet(struct Bullet* bullet){
-    if (bullet->transparent == 0){
-    	bullet->x = bullet->x + bullet->dx;
-    	bullet->y = bullet->y + bullet->dy;
-    	if (bullet->x > SCREEN_WIDTH || bullet->y > SCREEN_HEIGHT || bullet->x < 0 || bullet->y < 0){
-	    bullet->x = 0;
-	    bullet->y = 0;
-	    bullet->dx = 0;
-	    bullet->dy = 0;
-	    bullet->transparent = 1;
-	    sprite_set_offset(bullet->sprite, 90);
-    	}
-    	sprite_position(bullet->sprite, bullet->x, bullet->y);
+/* show a size by size sprite at a place in the world where the camera puts it,
+ * or hide it if the camera can't see it */
+void sprite_place(struct SpriteTable* table, struct Sprite* sprite, const struct Camera* camera,
+        int x, int y, int size) {
+    if (camera_sees(camera, x, y, size, size)) {
+        sprite_position(table, sprite, x - camera->x, y - camera->y);
+        sprite_set_visible(table, sprite, 1);
+    } else {
+        sprite_set_visible(table, sprite, 0);
     }
 }
 
-void update_slime(struct Slime* slime){
-    if (slime->dead == 1){
-	slime->delay=500;
-	slime->dead=0;
+/* the one place world positions become screen ones - every entity's sprite is
+ * put where the camera sees it, so scrolling never has to touch them */
+void sprites_place(struct Game* game) {
+    struct SpriteTable* table = &game->sprite_table;
+    const struct Camera* camera = &game->camera;
+
+    sprite_place(table, game->player.sprite, camera, FIXED_PIXELS(game->player.x),
+            FIXED_PIXELS(game->player.y), 16);
+
+    const struct Bullets* bullets = &game->bullets;
+    for (int n = 0; n < bullets->pool.count; n++) {
+        int i = bullets->pool.live[n];
+        sprite_place(table, bullets->sprite[i], camera, FIXED_PIXELS(bullets->x[i]),
+                FIXED_PIXELS(bullets->y[i]), 8);
     }
-    if (slime->delay == 0){
-    	if (slime->id == 1){  	
-            sprite_position(slime->sprite, 120, 0);
-            slime->x = 120;
-            slime->y = 0;
-        }
-        if (slime->id == 2){
-            sprite_position(slime->sprite, 120, 144);
-            slime->x = 120;
-            slime->y = 144;
-        }
-        if (slime->id == 3){
-            sprite_position(slime->sprite, 16, 80);
-            slime->x = 16;
-            slime->y = 80;
+
+    const struct Slimes* slimes = &game->slimes;
+    for (int n = 0; n < slimes->pool.count; n++) {
+        int i = slimes->pool.live[n];
+        if (slimes->flags[i] & SLIME_DEAD) {
+            /* it goes as soon as it is killed, and is taken out next frame */
+            sprite_set_visible(table, slimes->sprite[i], 0);
+        } else {
+            sprite_place(table, slimes->sprite[i], camera, FIXED_PIXELS(slimes->x[i]),
+                    FIXED_PIXELS(slimes->y[i]), 16);
         }
-        if (slime->id == 4){
-            sprite_position(slime->sprite, 224, 80);
-            slime->x = 224;
-            slime->y = 80;
+    }
+}
+
+/* point every slime which is out towards the player */
+void slimes_move(struct Slimes* slimes, struct Player* player, const struct FlowField* flow, int wave) {
+    int speed = SLIME_SPEED + wave * SLIME_SPEED_PER_WAVE;
+    if (speed > FIXED_ONE) {
+        speed = FIXED_ONE;
+    }
+
+    for (int n = 0; n < slimes->pool.count; n++) {
+        int i = slimes->pool.live[n];
+        if (!(slimes->flags[i] & SLIME_DEAD)) {
+            slime_move(slimes, i, player, flow, speed);
         }
-        slime->delay = -1;
-    } else if(slime->delay<0){
-   	sprite_position(slime->sprite, slime->x, slime->y);    
-    } else {
-    	sprite_position(slime->sprite, 240, 240);
-    	slime->delay= slime->delay-1;
-    }   	
+    }
+
+    /* the dead ones have no speed, so they stay put until they are taken out */
+    physics_move(slimes->x, slimes->y, slimes->vx, slimes->vy,
+            slimes->pool.live, slimes->pool.count);
 }
 
-void collision_check(struct Player* player, struct Slime* slime){
-    if (player->x >= slime->x && player->x < slime->x+16 && player->y >= slime->y && player->y < slime->y+16 || player->x+16 >= slime->x && player->x+16 < slime->x+16 && player->y >= slime->y && player->y < slime->y+16 || player->x >= slime->x && player->x < slime->x+16 && player->y+16 >= slime->y && player->y+16 < slime->y+16 || player->x+16 >= slime->x && player->x+16 < slime->x+16 && player->y+16 >= slime->y && player->y+16 < slime->y+16){
-    	if (player->invincible == 0){
-    	    player->health == player->health-1;
-    	    player->invincible == 30;
+/* speed the player up or slow it down, stop it at solid tiles, and move it -
+ * near the edges of the screen the camera follows it */
+void player_physics(struct Game* game) {
+    struct Player* player = &game->player;
+    static const unsigned char only[1] = {0};
+
+    physics_accelerate(&player->vx, &player->vy, &player->ax, &player->ay,
+            PLAYER_FRICTION, only, 1);
+
+    /* the player moves less than a pixel a frame, so only the tiles touching
+     * it can be in the way */
+    int px = FIXED_PIXELS(player->x);
+    int py = FIXED_PIXELS(player->y);
+    if (player->vx != 0 && edge_blocked(px, py, player->vx, 0)) {
+        player->vx = 0;
+    }
+    if (player->vy != 0 && edge_blocked(px, py, 0, player->vy)) {
+        player->vy = 0;
+    }
+    physics_move(&player->x, &player->y, &player->vx, &player->vy, only, 1);
+
+    camera_follow(&game->camera, px, py, FIXED_PIXELS(player->x) - px,
+            FIXED_PIXELS(player->y) - py, 16, 16, player->border);
+}
+
+/* the frames after being hit before the player can be hit again */
+#define PLAYER_INVINCIBLE_TIME 30
+
+void collision_check(struct Player* player, struct Slimes* slimes, int i,
+        struct TimerWheel* timers){
+    int sx = FIXED_PIXELS(slimes->x[i]);
+    int sy = FIXED_PIXELS(slimes->y[i]);
+    int px = FIXED_PIXELS(player->x);
+    int py = FIXED_PIXELS(player->y);
+    if (slimes->flags[i] & SLIME_DEAD) {
+        return;
+    }
+    /* a corner of the player, which reaches a pixel past its sprite, is over the slime */
+    if (px <= sx + 15 && px + 16 >= sx && py <= sy + 15 && py + 16 >= sy) {
+    	if (!timer_pending(&player->invincible)){
+    	    player->health = player->health-1;
+    	    timer_add(timers, &player->invincible, PLAYER_INVINCIBLE_TIME);
     	}
     }	
 }
 
+/* check the player against the slimes near it */
+void collisions_check(struct Player* player, struct Slimes* slimes, const struct Grid* grid,
+        struct TimerWheel* timers) {
+    unsigned char nearby[GRID_MAX_ITEMS];
+
+    /* the player's corners reach one pixel past its 16x16 sprite */
+    int count = grid_query(grid, FIXED_PIXELS(player->x), FIXED_PIXELS(player->y), 17, 17, nearby, GRID_MAX_ITEMS);
+    for (int n = 0; n < count; n++) {
+        collision_check(player, slimes, nearby[n], timers);
+    }
+}
+
 int calc_wave(int kills, int wave);
 
-/* the main function */
-int main() {
+/* put the player and enemies back to how they start */
+void game_start(struct Game* game) {
+    /* clear all the sprites on screen now, and give back their VRAM slots */
+    sprite_clear(&game->sprite_table);
+    anim_clear(&game->animator);
+
+    /* and forget every countdown, they all start again */
+    timer_wheel_clear(&game->timers);
+
+    /* the display goes back to the same on every line */
+    raster_clear(&game->raster);
+
+    /* create the player */
+    player_init(game);
+
+    bullets_init(game);
+    slimes_init(game);
+    flow_init(&game->flow, &background_collision);
+
+    timer_init(&game->bullet_delay, 0, 0);
+    game->kills = 0;
+    game->wave = 0;
+}
+
+/* set up the starting state of a game, the map goes straight into screen
+ * unless there isn't one */
+void game_setup(struct Game* game, volatile unsigned short* screen) {
+    /* nothing is waiting to be copied yet */
+    dma_queue_init(&game->dma, DMA_BUDGET);
+    game->sprite_table.oam_bytes_last = 0;
+    game->sprite_table.oam_bytes_total = 0;
+    game->sprite_table.shown_max = 0;
+    game->sprite_table.shown_total = 0;
+    for (int band = 0; band < SPRITE_BANDS; band++) {
+        game->sprite_table.band_max[band] = 0;
+        game->sprite_table.band_total[band] = 0;
+        game->sprite_table.band_dropped[band] = 0;
+    }
+    game->sprite_table.mux_frames = 0;
+    game->sprite_table.too_tall = 0;
+    game->sprite_table.refused = 0;
+
+    /* nothing is multiplexed until there are too many sprites */
+    game->sprite_table.mux.active[0] = 0;
+    game->sprite_table.mux.active[1] = 0;
+    game->sprite_table.mux.back = 0;
+    game->sprite_table.mux.front = 1;
+    game->sprite_table.multiplexed = 0;
+
+    timer_wheel_init(&game->timers);
+    spawn_queue_init(&game->slimes.spawns);
+    raster_init(&game->raster);
+
+    /* the frames come straight out of the sheet in the ROM */
+    anim_init(&game->animator, asset_sprite_sheet, (volatile unsigned int*) sprite_image_memory,
+            &game->dma, &game->timers);
+
+    /* start with the camera at the top left of the world */
+    game->camera.x = 0;
+    game->camera.y = 0;
+
+    game_start(game);
+
+    /* no keys are down before the first frame */
+    game->input.held = 0;
+    game->input.pressed = 0;
+    game->input.released = 0;
+
+    /* the keys are live until a log is started */
+    input_log_init(&game->input_log, (volatile unsigned char*) SRAM_ADDRESS(0), INPUT_LOG_SIZE);
+
+    /* and put the world around it into the background */
+    stream_init(&game->stream, asset_world_map, asset_world_width, asset_world_height,
+            screen, game->camera.x, game->camera.y);
+}
+
+/* set up the display and the starting state of the game */
+void game_init(struct Game* game) {
     /* we set the mode to mode 0 with bg0 on */
     *display_control = MODE0 | BG0_ENABLE | SPRITE_ENABLE | SPRITE_MAP_1D;
 
@@ -937,181 +1473,168 @@ int main() {
     /* setup the sprite image data */
     setup_sprite_image();
 
-    /* clear all the sprites on screen now */
-    sprite_clear();
+    /* start the frame timing */
+    interrupt_init();
 
-    /* create the player */
-    struct Player player;
-    player_init(&player);
-    
-    struct Bullet bullet1;
-    bullet_init(&bullet1);
-    
-    struct Bullet bullet2;
-    bullet_init(&bullet2);
-    
-    struct Bullet bullet3;
-    bullet_init(&bullet3);
-    
-    struct Slime slime1;
-    slime_init(&slime1, 1, 100);
-    
-    struct Slime slime2;
-    slime_init(&slime2, 2, 400);
-    
-    struct Slime slime3;
-    slime_init(&slime3, 3, 800);
-    
-    struct Slime slime4;
-    slime_init(&slime4, 4, 1000);
-    
-    int bullet_delay = 0;
+    game_setup(game, screen_block(16));
 
-    /* set initial scroll to 0 */
-    int xscroll = 0;
-    int yscroll = 0;
-    
-    int kills = 0;
-    int wave = 0; 
+    /* holding R as the game starts records the keys of the run to SRAM, and
+     * holding L plays back the last one */
+    if (buttons_read() & BUTTON_L) {
+        input_replay(&game->input_log);
+    } else if (buttons_read() & BUTTON_R) {
+        input_record(&game->input_log);
+    }
+}
+
+/* set up a game which is never drawn */
+void game_init_headless(struct Game* game) {
+    game_setup(game, 0);
+}
+
+/* the flow field's window is lined up on the screen, which is 30x20 tiles, with
+ * the spare tiles around the edges */
+#define FLOW_LEFT_MARGIN 1
+#define FLOW_TOP_MARGIN 6
+
+/* run the game logic for one frame */
+void game_step(struct Game* game, unsigned short keys) {
+    struct Player* player = &game->player;
+
+    /* run out the countdowns which are up this frame */
+    timer_wheel_tick(&game->timers);
+
+    /* take this frame's keys, or the ones from a replay */
+    input_update(&game->input, input_log_step(&game->input_log, keys));
+
+    BENCH_BEGIN(BENCH_BULLET_CHECK);
+    bullets_update(&game->bullets, &game->sprite_table, &game->camera);
+    BENCH_END(BENCH_BULLET_CHECK);
+
+    BENCH_BEGIN(BENCH_SLIME_MOVE);
+    slimes_update(&game->slimes, &game->sprite_table, &game->camera);
+    BENCH_END(BENCH_SLIME_MOVE);
+
+    /* now the arrow keys move the koopa */
+    BENCH_BEGIN(BENCH_PLAYER_UPDATE);
+    if (game->input.held & BUTTON_RIGHT) {
+        player_right(player);
+    } else if (game->input.held & BUTTON_LEFT) {
+        player_left(player);
+    } else if (game->input.held & BUTTON_UP) {
+        player_up(player);
+    } else if (game->input.held & BUTTON_DOWN) {
+        player_down(player);
+    } else {
+        player_stop(player);
+    }
+    player_physics(game);
+    stream_update(&game->stream, game->camera.x, game->camera.y);
+
+    /* check for jumping */
+    if ((game->input.held & BUTTON_A) && !timer_pending(&game->bullet_delay)) {
+        shoot(player, &game->bullets);
+        timer_add(&game->timers, &game->bullet_delay, BULLET_DELAY);
+    }
+    BENCH_END(BENCH_PLAYER_UPDATE);
+
+    /* carry on working out the paths to the player, then follow them */
+    BENCH_BEGIN(BENCH_SLIME_MOVE);
+    flow_update(&game->flow, (FIXED_PIXELS(player->x) + 4) >> 3,
+            (FIXED_PIXELS(player->y) + 4) >> 3,
+            (game->camera.x >> 3) - FLOW_LEFT_MARGIN, (game->camera.y >> 3) - FLOW_TOP_MARGIN,
+            FLOW_BUDGET);
+    slimes_move(&game->slimes, player, &game->flow, game->wave);
+    BENCH_END(BENCH_SLIME_MOVE);
+
+    /* sort the slimes into cells for the collision checks */
+    BENCH_BEGIN(BENCH_BULLET_CHECK);
+    grid_build(&game->slime_grid, game->slimes.x, game->slimes.y, FIXED_SHIFT,
+            game->camera.x, game->camera.y, game->slimes.pool.live, game->slimes.pool.count);
+    game->kills += bullets_check(&game->bullets, &game->slimes, &game->slime_grid,
+            &game->sprite_table);
+    BENCH_END(BENCH_BULLET_CHECK);
+
+    BENCH_BEGIN(BENCH_CALC_WAVE);
+    int wave = calc_wave(game->kills, game->wave);
+    BENCH_END(BENCH_CALC_WAVE);
+
+    /* a new wave brings its slimes with it */
+    if (wave != game->wave) {
+        game->wave = wave;
+        slimes_wave(&game->slimes, wave);
+    }
+
+    BENCH_BEGIN(BENCH_COLLISION_CHECK);
+    collisions_check(player, &game->slimes, &game->slime_grid, &game->timers);
+    BENCH_END(BENCH_COLLISION_CHECK);
+
+    /* step every animation on, after the controls have picked the player's */
+    BENCH_BEGIN(BENCH_PLAYER_UPDATE);
+    animations_update(game);
+    BENCH_END(BENCH_PLAYER_UPDATE);
+
+    if (player->health==0){
+        game_start(game);
+    }
+
+    /* put the sprites where the camera sees everything, and queue up the new
+     * frames and the changed sprites for the vblank */
+    BENCH_BEGIN(BENCH_SPRITE_UPDATE);
+    sprites_place(game);
+    anim_queue(&game->animator);
+    sprite_update_all(&game->sprite_table, &game->dma);
+    BENCH_END(BENCH_SPRITE_UPDATE);
+}
+
+/* run the game logic for one frame with the keypad */
+void game_update(struct Game* game) {
+    game_step(game, buttons_read());
+}
+
+/* copy the scroll, the map and everything queued over, this must be called
+ * during vblank */
+void game_draw(struct Game* game) {
+    *bg0_x_scroll = game->camera.x;
+    *bg0_y_scroll = game->camera.y;
+
+    /* an effect on the scroll starts from its own first line instead */
+    raster_show(&game->raster);
+
+    BENCH_BEGIN(BENCH_MAP_STREAM);
+    stream_draw(&game->stream);
+    BENCH_END(BENCH_MAP_STREAM);
+
+    BENCH_BEGIN(BENCH_DMA_FLUSH);
+    sprite_mux_show(&game->sprite_table);
+    dma_queue_flush(&game->dma);
+    BENCH_END(BENCH_DMA_FLUSH);
+}
+
+#ifndef HOST
+/* the main function */
+int main() {
+    /* the game is too big for the stack in IWRAM */
+    static struct Game game;
+    game_init(&game);
+
+#ifdef PROFILE
+    profile_init();
+#endif
 
     /* loop forever */
     while (1) {
-        /* update sprites */
-        player_update(&player, xscroll);
-        update_bullet(&bullet1);
-        update_bullet(&bullet2);
-        update_bullet(&bullet3);
-        update_slime(&slime1);  
-        update_slime(&slime2);
-        update_slime(&slime3);
-        update_slime(&slime4);  
-   
-               
-
-        /* now the arrow keys move the koopa */
-        if (button_pressed(BUTTON_RIGHT)) {
-            if (player_right(&player, xscroll, yscroll)) {
-                xscroll++;
-                slime1.x--;
-                slime2.x--;
-                slime3.x--;
-                slime4.x--;                
-            }
-        } else if (button_pressed(BUTTON_LEFT)) {
-            if (player_left(&player, xscroll, yscroll)) {
-                xscroll--;
-                slime1.x++;
-                slime2.x++;
-                slime3.x++;
-                slime4.x++;
-            }
-        } else if (button_pressed(BUTTON_UP)) {
-            if (player_up(&player, xscroll, yscroll)) {
-                yscroll--;
-                slime1.y++;
-                slime2.y++;
-                slime3.y++;
-                slime4.y++;
-            }
-        } else if (button_pressed(BUTTON_DOWN)) {
-            if (player_down(&player, xscroll, yscroll)) {
-                yscroll++;
-                slime1.y--;
-                slime2.y--;
-                slime3.y--;
-                slime4.y--;
-            }
-        } else {
-            player_stop(&player);
-        }
+        game_update(&game);
 
-        /* check for jumping */
-        if (button_pressed(BUTTON_A) && bullet_delay == 0) { 
-            if (bullet1.transparent == 1){
-            	shoot(&player, &bullet1);
-            } else if (bullet2.transparent == 1){
-            	shoot(&player, &bullet2);
-            } else if (bullet3.transparent == 1){
-            	shoot(&player, &bullet3);
-            }
-            bullet_delay = 20;            	
-        }
-        
-        if (slime1.dead==0 && slime1.delay < 0){
-            slime_move(&slime1, &player, xscroll, yscroll, wave);
-        }
-        if (slime2.dead==0 && slime2.delay < 0){
-            slime_move(&slime2, &player, xscroll, yscroll, wave);
-        }
-        if (slime3.dead==0 && slime3.delay < 0){
-            slime_move(&slime3, &player, xscroll, yscroll, wave);
-        }
-        if (slime4.dead==0 && slime4.delay < 0){
-            slime_move(&slime4, &player, xscroll, yscroll, wave);
-        }
-        
-        bullet_check(&bullet1, &slime1);
-        bullet_check(&bullet2, &slime1);
-        bullet_check(&bullet3, &slime1);
-        
-        bullet_check(&bullet1, &slime2);
-        bullet_check(&bullet2, &slime2);
-        bullet_check(&bullet3, &slime2);
-        
-        bullet_check(&bullet1, &slime3);
-        bullet_check(&bullet2, &slime3);
-        bullet_check(&bullet3, &slime3);
-        
-        bullet_check(&bullet1, &slime4);
-        bullet_check(&bullet2, &slime4);
-        bullet_check(&bullet3, &slime4);
-        
-        if (slime1.dead=1){
-            kills++;
-        }
-        if (slime2.dead=1){
-            kills++;
-        }
-        if (slime3.dead=1){
-            kills++;
-        }
-        if (slime4.dead=1){
-            kills++;
-        }
-                
-        if (bullet_delay != 0){
-            bullet_delay = bullet_delay-1;
-        }
-        
-        wave = calc_wave(kills, wave);
-        collision_check(&player, &slime1);
-        collision_check(&player, &slime2);
-        collision_check(&player, &slime3);
-        collision_check(&player, &slime4);
-        player.invincible = player.invincible-1;
-        
-        if (player.health==0){
-	    sprite_clear();
-	    player_init(&player);
-	    bullet_init(&bullet1);
-	    bullet_init(&bullet2);
-	    bullet_init(&bullet3);
-	    slime_init(&slime1, 1, 100);
-	    slime_init(&slime2, 1, 400);
-	    slime_init(&slime3, 1, 800);
-	    slime_init(&slime4, 1, 1000);
-	    kills = 0;
-	    wave=0;
-	}
-        
-        /* wait for vblank before scrolling and moving sprites */
+        /* sleep until vblank before scrolling and moving sprites */
         wait_vblank();
-        *bg0_x_scroll = xscroll;
-        *bg0_y_scroll = yscroll;
-        sprite_update_all();
+        game_draw(&game);
 
-        /* delay some */
-        delay(300);
+#ifdef PROFILE
+        /* log the cycles each section takes while select is held */
+        profile_frame(game.input.held & BUTTON_SELECT);
+#endif
     }
 }
+#endif
 
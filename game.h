@@ -0,0 +1,305 @@
+/*
+ * game.h
+ * the state of the game, shared with the host benchmark
+ */
+
+#pragma once
+#ifndef GAME_H
+#define GAME_H
+
+#include "anim.h"
+#include "camera.h"
+#include "dma.h"
+#include "flow.h"
+#include "grid.h"
+#include "input.h"
+#include "physics.h"
+#include "raster.h"
+#include "spawn.h"
+#include "stream.h"
+#include "timer.h"
+
+/* a sprite is a moveable image on the screen */
+struct Sprite {
+    unsigned short attribute0;
+    unsigned short attribute1;
+    unsigned short attribute2;
+    unsigned short attribute3;
+};
+
+/* there are 128 entries in OAM on the GBA */
+#define OAM_ENTRIES 128
+
+/* the sprites a game can make - more than OAM holds, as long as they aren't all
+ * on the screen at once, or are spread down it enough to be multiplexed */
+#define NUM_SPRITES 256
+
+/* the number of layers sprites can be drawn in, each one in front of those
+ * below it whatever their depth */
+#define SPRITE_LAYERS 4
+
+/* with more sprites on the screen than OAM holds, it is split into bands of
+ * lines, and the sprites whose tops are in each band share one half of OAM -
+ * the halves take turns down the screen, so a half is copied over during the
+ * band before its next one, once the sprites of its last band are finished */
+#define SPRITE_BAND_HEIGHT 32
+#define SPRITE_BANDS 5
+#define SPRITE_BAND_ENTRIES (OAM_ENTRIES / 2)
+
+/* the tallest sprite which can be multiplexed, any taller and one starting at
+ * the bottom of a band is still being drawn when its half is copied over - the
+ * copy is spread over that many hblanks before the band starts */
+#define SPRITE_MUX_HEIGHT 16
+
+/* the sprites of the bands after the first two, which are copied into OAM as
+ * the screen is drawn - one set is shown while the next frame's is made */
+struct SpriteMux {
+    struct Sprite bands[2][SPRITE_BANDS - 2][SPRITE_BAND_ENTRIES];
+
+    /* whether each set needs multiplexing, which set the next frame goes in,
+     * and the one being shown */
+    int active[2];
+    int back;
+    int front;
+
+    /* the band being copied into OAM, or waited for, while the screen is drawn */
+    int band;
+    int copying;
+};
+
+/* the sprites a game draws into, and the copy of OAM made from them which is
+ * copied over during vblank - only the sprites which aren't hidden go into OAM,
+ * packed into the lowest entries front to back, and the rest of OAM is
+ * disabled, so the hardware only spends time on what is on the screen */
+struct SpriteTable {
+    /* the last sprite is handed out once all the others have been, and is
+     * never shown */
+    struct Sprite sprites[NUM_SPRITES + 1];
+    int next;
+
+    /* the layer of each sprite - within a layer, the lower down the screen a
+     * sprite's feet are the further in front it is */
+    unsigned char layer[NUM_SPRITES + 1];
+
+    /* whether the sprites are put in OAM front to back, or just in the order
+     * they were made, which the benchmark uses to compare */
+    int depth_sort;
+
+    /* one bit for each sprite which has changed since it was last packed */
+    unsigned int dirty[NUM_SPRITES / 32 + 1];
+
+    /* the packed copy of OAM, the entry each sprite went in last frame (or
+     * SPRITE_NOT_SHOWN), and the number of entries which were used */
+    struct Sprite oam[OAM_ENTRIES];
+    unsigned char oam_entry[NUM_SPRITES];
+    int shown;
+
+    /* one bit for each entry of the copy which has changed since it was last
+     * copied to OAM, so only those need to be copied during vblank */
+    unsigned int oam_dirty[OAM_ENTRIES / 32];
+
+    /* the bands of sprites for when there are too many for OAM - the first two
+     * go in the copy of OAM, and this holds the rest - and whether the last
+     * frame packed needed them */
+    struct SpriteMux mux;
+    int multiplexed;
+
+    /* the sprites whose tops were in each band at the last frame, the most in
+     * one frame, and in total, and the ones left out because their band's
+     * half of OAM was full */
+    int band_last[SPRITE_BANDS];
+    int band_max[SPRITE_BANDS];
+    unsigned long band_total[SPRITE_BANDS];
+    unsigned long band_dropped[SPRITE_BANDS];
+
+    /* the frames which were multiplexed, the sprites left out of them for
+     * being taller than SPRITE_MUX_HEIGHT, and the sprites asked for once all
+     * of them had been made */
+    unsigned long mux_frames;
+    unsigned long too_tall;
+    unsigned long refused;
+
+    /* the number of bytes queued for OAM at the last frame, and in total */
+    unsigned int oam_bytes_last;
+    unsigned long oam_bytes_total;
+
+    /* the most sprites shown in a frame, and the number shown in total */
+    int shown_max;
+    unsigned long shown_total;
+};
+
+/* the entry of a sprite which wasn't in OAM last frame */
+#define SPRITE_NOT_SHOWN 0xff
+
+/* a struct for the koopa's logic and behavior */
+struct Player {
+    /* the actual sprite attribute info */
+    struct Sprite* sprite;
+
+    /* the x and y postion in the world in 1/256 pixels */
+    int x, y;
+
+    /* the velocity in 1/256 pixels/frame */
+    int vx, vy;
+
+    /* the acceleration from the controls in 1/256 pixels/frame^2 */
+    int ax, ay;
+
+    /* the clip the player is playing, standing or walking the way it faces */
+    struct Animation* animation;
+
+    int facing;
+
+    /* the number of pixels away from the edge of the screen the player stays,
+     * the camera moves to keep it there */
+    int border;
+
+    int health;
+
+    /* running for a while after the player is hit, when it can't be hit again */
+    struct Timer invincible;
+};
+
+/* the most entities a pool can hold, the slot numbers have to fit in a byte */
+#define MAX_POOL 64
+
+/* the number of slimes and bullets which can be alive at once */
+#define MAX_SLIMES 16
+#define MAX_BULLETS 3
+
+/* marks the end of a free list */
+#define NO_SLOT 0xff
+
+/* keeps track of which slots of an entity pool are in use - the free slots are
+ * linked together so spawning is quick, and the used ones are packed at the
+ * front of live so each system only loops over entities which exist */
+struct Pool {
+    int capacity;
+    int count;
+    int free_head;
+    unsigned char live[MAX_POOL];
+    unsigned char where[MAX_POOL];
+    unsigned char next_free[MAX_POOL];
+};
+
+/* all of the bullets, one array per field so that the loops over them only
+ * pull in the fields they use */
+struct Bullets {
+    struct Pool pool;
+
+    /* the x and y postion in the world in 1/256 pixels, and velocity in 1/256
+     * pixels/frame */
+    int x[MAX_BULLETS];
+    int y[MAX_BULLETS];
+    int vx[MAX_BULLETS];
+    int vy[MAX_BULLETS];
+
+    /* the actual sprite attribute info, and the animation which shows either
+     * the bullet or nothing */
+    struct Sprite* sprite[MAX_BULLETS];
+    struct Animation* animation[MAX_BULLETS];
+};
+
+/* the flags kept for each slime */
+#define SLIME_DEAD (1 << 0)
+
+/* all of the slimes, stored the same way as the bullets - only the slimes
+ * which are out are in the pool, the rest wait in the spawn queue */
+struct Slimes {
+    struct Pool pool;
+    struct SpawnQueue spawns;
+
+    /* the x and y postion in the world in 1/256 pixels, and velocity in 1/256
+     * pixels/frame */
+    int x[MAX_SLIMES];
+    int y[MAX_SLIMES];
+    int vx[MAX_SLIMES];
+    int vy[MAX_SLIMES];
+
+    unsigned char flags[MAX_SLIMES];
+
+    /* which of the spawn points the slime appears at */
+    unsigned char spawn[MAX_SLIMES];
+
+    /* the actual sprite attribute info */
+    struct Sprite* sprite[MAX_SLIMES];
+};
+
+/* everything that changes from one frame of the game to the next */
+struct Game {
+    /* the keys for this frame, and the log they are recorded to or replayed
+     * from */
+    struct Input input;
+    struct InputLog input_log;
+
+    /* the sprites, and the animations which pick their tiles */
+    struct SpriteTable sprite_table;
+    struct Animator animator;
+
+    /* the copies waiting for vblank, which count the bytes queued and copied */
+    struct DmaQueue dma;
+
+    /* the countdowns, which move on a frame at the start of each update */
+    struct TimerWheel timers;
+
+    struct Player player;
+
+    struct Bullets bullets;
+    struct Slimes slimes;
+
+    /* the slimes sorted into screen cells, rebuilt each frame */
+    struct Grid slime_grid;
+
+    /* the paths from everywhere on the screen to the player */
+    struct FlowField flow;
+
+    /* the part of the world loaded into the background */
+    struct MapStream stream;
+
+    /* running after a shot, until the next one is allowed */
+    struct Timer bullet_delay;
+
+    /* what the screen shows of the world */
+    struct Camera camera;
+
+    /* the effects changing the display from line to line, none unless a
+     * table is built for them */
+    struct Raster raster;
+
+    int kills;
+    int wave;
+};
+
+/* set up the display and the starting state of the game */
+void game_init(struct Game* game);
+
+/* set up the starting state of a game which is never drawn - the host can run
+ * any number of these side by side, the hardware is left alone and the keys
+ * all come from game_step */
+void game_init_headless(struct Game* game);
+
+/* run the game logic for one frame with the given keys held, this does not
+ * touch the display */
+void game_step(struct Game* game, unsigned short keys);
+
+/* run the game logic for one frame with the keypad's keys */
+void game_update(struct Game* game);
+
+/* copy the scroll and everything queued to the hardware, called during vblank */
+void game_draw(struct Game* game);
+
+/* hide every sprite and forget them all, with depth sorting on */
+void sprite_clear(struct SpriteTable* table);
+
+/* pack the sprites which aren't hidden into the lowest entries of the copy of
+ * OAM, marking the entries which changed */
+void sprite_pack(struct SpriteTable* table);
+
+/* pack the sprites, and queue up all of the entries of OAM which have changed */
+void sprite_update_all(struct SpriteTable* table, struct DmaQueue* queue);
+
+/* show the sprites packed for the frame about to be drawn, multiplexing them
+ * while it is drawn if there are too many, this must be called during vblank */
+void sprite_mux_show(struct SpriteTable* table);
+
+#endif
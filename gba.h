@@ -0,0 +1,46 @@
+/*
+ * gba.h
+ * addresses of the GBA memory regions used by the game
+ */
+
+#pragma once
+#ifndef GBA_H
+#define GBA_H
+
+/* on the GBA every register and video memory lives at a fixed address, for a
+ * host build (-DHOST) the same regions are backed by ordinary arrays so the
+ * game logic can run and be measured on a normal computer */
+#ifdef HOST
+
+#include "host.h"
+
+#define IWRAM_ADDRESS(offset) ((char*) host_iwram + (offset))
+#define IO_ADDRESS(offset) ((char*) host_io + (offset))
+#define PALETTE_ADDRESS(offset) ((char*) host_palette + (offset))
+#define VRAM_ADDRESS(offset) ((char*) host_vram + (offset))
+#define OAM_ADDRESS(offset) ((char*) host_oam + (offset))
+#define SRAM_ADDRESS(offset) ((char*) host_sram + (offset))
+
+#else
+
+#define IWRAM_ADDRESS(offset) (0x3000000 + (offset))
+#define IO_ADDRESS(offset) (0x4000000 + (offset))
+#define PALETTE_ADDRESS(offset) (0x5000000 + (offset))
+#define VRAM_ADDRESS(offset) (0x6000000 + (offset))
+#define OAM_ADDRESS(offset) (0x7000000 + (offset))
+#define SRAM_ADDRESS(offset) (0xe000000 + (offset))
+
+/* a profile build (-DPROFILE) times the same sections as the host benchmark
+ * with the hardware timers, otherwise the markers compile to nothing */
+#ifdef PROFILE
+#include "profile.h"
+#define BENCH_BEGIN(section) profile_begin(section)
+#define BENCH_END(section) profile_end(section)
+#else
+#define BENCH_BEGIN(section)
+#define BENCH_END(section)
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * grid.c
+ * uniform grid over the screen for finding which entities might overlap
+ */
+
+#include "grid.h"
+
+/* which column or row a coordinate falls in, clamped to the grid */
+static int grid_column(int x) {
+    x >>= GRID_CELL_SHIFT;
+    if (x < 0) {
+        return 0;
+    }
+    if (x >= GRID_COLUMNS) {
+        return GRID_COLUMNS - 1;
+    }
+    return x;
+}
+
+static int grid_row(int y) {
+    y >>= GRID_CELL_SHIFT;
+    if (y < 0) {
+        return 0;
+    }
+    if (y >= GRID_ROWS) {
+        return GRID_ROWS - 1;
+    }
+    return y;
+}
+
+void grid_build(struct Grid* grid, const int* x, const int* y, int shift,
+        int left, int top, const unsigned char* ids, int count) {
+    unsigned char cells[GRID_MAX_ITEMS];
+    int sizes[GRID_CELLS];
+
+    if (count > GRID_MAX_ITEMS) {
+        count = GRID_MAX_ITEMS;
+    }
+    grid->count = count;
+    grid->left = left;
+    grid->top = top;
+
+    /* count how many entities land in each cell */
+    for (int c = 0; c < GRID_CELLS; c++) {
+        sizes[c] = 0;
+    }
+    for (int n = 0; n < count; n++) {
+        int id = ids[n];
+        int cell = grid_row((y[id] >> shift) - top) * GRID_COLUMNS +
+            grid_column((x[id] >> shift) - left);
+        cells[n] = cell;
+        sizes[cell]++;
+    }
+
+    /* work out where each cell's bucket starts */
+    int total = 0;
+    for (int c = 0; c < GRID_CELLS; c++) {
+        grid->start[c] = total;
+        total += sizes[c];
+        sizes[c] = grid->start[c];
+    }
+    grid->start[GRID_CELLS] = total;
+
+    /* and drop each entity into its bucket */
+    for (int n = 0; n < count; n++) {
+        grid->items[sizes[cells[n]]++] = ids[n];
+    }
+}
+
+int grid_query(const struct Grid* grid, int x, int y, int w, int h,
+        unsigned char* found, int max) {
+    x -= grid->left;
+    y -= grid->top;
+
+    /* anything whose corner is up to an object's size before the box can still
+     * reach into it */
+    int left = grid_column(x - (GRID_OBJECT_SIZE - 1));
+    int right = grid_column(x + w - 1);
+    int top = grid_row(y - (GRID_OBJECT_SIZE - 1));
+    int bottom = grid_row(y + h - 1);
+
+    int count = 0;
+    for (int row = top; row <= bottom; row++) {
+        /* the cells of a row are next to each other, so their buckets are too */
+        int first = grid->start[row * GRID_COLUMNS + left];
+        int last = grid->start[row * GRID_COLUMNS + right + 1];
+        for (int n = first; n < last && count < max; n++) {
+            found[count++] = grid->items[n];
+        }
+    }
+    return count;
+}
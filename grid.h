@@ -0,0 +1,48 @@
+/*
+ * grid.h
+ * uniform grid over the screen for finding which entities might overlap
+ */
+
+#pragma once
+#ifndef GRID_H
+#define GRID_H
+
+/* the grid is made of 32x32 pixel cells covering the screen, wherever it is in
+ * the world, and anything off the edge is counted as being in the nearest cell */
+#define GRID_CELL_SHIFT 5
+#define GRID_COLUMNS 8
+#define GRID_ROWS 5
+#define GRID_CELLS (GRID_COLUMNS * GRID_ROWS)
+
+/* the most entities one grid can hold */
+#define GRID_MAX_ITEMS 128
+
+/* the largest width or height of an entity in the grid - nothing can be bigger
+ * than a cell, so each one is only stored in the cell of its top left corner */
+#define GRID_OBJECT_SIZE 16
+
+/* the entities bucketed by cell: the ones in cell c are items[start[c]] up to
+ * items[start[c + 1]] */
+struct Grid {
+    /* the pixel at the top left of the grid */
+    int left;
+    int top;
+
+    int count;
+    unsigned char start[GRID_CELLS + 1];
+    unsigned char items[GRID_MAX_ITEMS];
+};
+
+/* rebuild the grid with its top left at pixel (left, top) from the positions of
+ * count entities - ids[n] is what gets stored for the entity at
+ * (x[ids[n]], y[ids[n]]), and the positions are shifted down by shift bits to
+ * get pixels */
+void grid_build(struct Grid* grid, const int* x, const int* y, int shift,
+        int left, int top, const unsigned char* ids, int count);
+
+/* find the entities which could overlap a w by h box at (x, y), storing up to
+ * max of their ids in found and returning how many there were */
+int grid_query(const struct Grid* grid, int x, int y, int w, int h,
+        unsigned char* found, int max);
+
+#endif
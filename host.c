@@ -0,0 +1,236 @@
+/*
+ * host.c
+ * stand-ins for the GBA hardware when the game is built for a computer
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+
+/* the registers are accessed as 16 and 32 bit values, so keep them aligned */
+unsigned short host_iwram[HOST_IWRAM_SIZE] __attribute__((aligned(4)));
+unsigned short host_io[HOST_IO_SIZE] __attribute__((aligned(4)));
+unsigned short host_palette[HOST_PALETTE_SIZE] __attribute__((aligned(4)));
+unsigned short host_vram[HOST_VRAM_SIZE] __attribute__((aligned(4)));
+unsigned short host_oam[HOST_OAM_SIZE] __attribute__((aligned(4)));
+unsigned char host_sram[HOST_SRAM_SIZE];
+
+/* halfword offsets of the registers the host side has to drive */
+#define HOST_DISPLAY_STATUS (0x004 / 2)
+#define HOST_SCANLINE_COUNTER (0x006 / 2)
+#define HOST_BUTTONS (0x130 / 2)
+#define HOST_INTERRUPT_ENABLE (0x200 / 2)
+
+/* the vcount interrupt's bit in the display status and enable registers */
+#define HOST_VCOUNT_STATUS (1 << 5)
+#define HOST_VCOUNT_INTERRUPT (1 << 2)
+
+/* the channels which copy at each hblank, with the addresses they have got to */
+static struct {
+    char* dest;
+    const char* source;
+    unsigned int control;
+} host_hblank[4];
+
+void (*host_vcount_handler)() = 0;
+
+/* the parts of a DMA control word */
+#define HOST_DMA_COUNT 0x0000ffff
+#define HOST_DMA_DEST_MODE(control) (((control) >> 21) & 3)
+#define HOST_DMA_SOURCE_MODE(control) (((control) >> 23) & 3)
+#define HOST_DMA_32 0x04000000
+
+void host_reset() {
+    memset(host_iwram, 0, sizeof(host_iwram));
+    memset(host_io, 0, sizeof(host_io));
+    memset(host_palette, 0, sizeof(host_palette));
+    memset(host_vram, 0, sizeof(host_vram));
+    memset(host_oam, 0, sizeof(host_oam));
+
+    memset(host_hblank, 0, sizeof(host_hblank));
+
+    /* no buttons held, and sitting in vblank */
+    host_io[HOST_BUTTONS] = 0x3ff;
+    host_io[HOST_SCANLINE_COUNTER] = 160;
+}
+
+/* how far an address moves after each unit for an address control mode */
+static int host_dma_step(int mode, int size) {
+    switch (mode) {
+        case 0: return size;   /* increment */
+        case 1: return -size;  /* decrement */
+        case 2: return 0;      /* fixed */
+        default: return size;  /* increment and reload */
+    }
+}
+
+void host_dma(void* dest, const void* source, unsigned int control) {
+    /* a count of 0 is the largest transfer DMA3 can do */
+    unsigned int count = control & HOST_DMA_COUNT;
+    if (count == 0) {
+        count = 0x10000;
+    }
+
+    int size = (control & HOST_DMA_32) ? 4 : 2;
+    int dest_step = host_dma_step(HOST_DMA_DEST_MODE(control), size);
+    int source_step = host_dma_step(HOST_DMA_SOURCE_MODE(control), size);
+
+    /* the common case of both addresses counting up is just a memmove */
+    if (dest_step == size && source_step == size) {
+        memmove(dest, source, count * size);
+        return;
+    }
+
+    char* d = (char*) dest;
+    const char* s = (const char*) source;
+    for (unsigned int i = 0; i < count; i++) {
+        memmove(d, s, size);
+        d += dest_step;
+        s += source_step;
+    }
+}
+
+void host_hblank_dma(int channel, void* dest, const void* source, unsigned int control) {
+    host_hblank[channel].dest = (char*) dest;
+    host_hblank[channel].source = (const char*) source;
+    host_hblank[channel].control = control;
+}
+
+int host_line(int line) {
+    host_io[HOST_SCANLINE_COUNTER] = line;
+
+    unsigned short status = host_io[HOST_DISPLAY_STATUS];
+    if ((status & HOST_VCOUNT_STATUS) && (status >> 8) == line &&
+            (host_io[HOST_INTERRUPT_ENABLE] & HOST_VCOUNT_INTERRUPT) && host_vcount_handler) {
+        host_vcount_handler();
+    }
+
+    /* there are no hblank copies during vblank */
+    if (line >= 160) {
+        return 0;
+    }
+
+    /* the channels go in order of priority, each carrying on from where it
+     * got to at the last hblank */
+    int oam = 0;
+    for (int channel = 0; channel < 4; channel++) {
+        unsigned int control = host_hblank[channel].control;
+        if (control == 0) {
+            continue;
+        }
+
+        unsigned int count = control & HOST_DMA_COUNT;
+        int size = (control & HOST_DMA_32) ? 4 : 2;
+        char* dest = host_hblank[channel].dest;
+        if (dest >= (char*) host_oam && dest < (char*) host_oam + sizeof(host_oam)) {
+            oam = 1;
+        }
+
+        /* an address counting up carries on past what was copied, a fixed one
+         * (such as a register) or a reloaded one starts from the same place */
+        host_dma(dest, host_hblank[channel].source, control);
+        if (HOST_DMA_SOURCE_MODE(control) == 0) {
+            host_hblank[channel].source += count * size;
+        }
+        if (HOST_DMA_DEST_MODE(control) == 0) {
+            host_hblank[channel].dest += count * size;
+        }
+    }
+    return oam;
+}
+
+/* counted by the interrupt handler on the GBA */
+extern volatile unsigned int vblank_count;
+
+void vblank_intr_wait() {
+    vblank_count++;
+}
+
+void host_set_buttons(unsigned short pressed) {
+    host_io[HOST_BUTTONS] = ~pressed & 0x3ff;
+}
+
+/* the game calls this assembly routine, so give the host a C version of it:
+ * every 4 kills per wave moves on to the next wave */
+int calc_wave(int kills, int wave) {
+    if (kills >= wave * 4) {
+        return wave + 1;
+    }
+    return wave;
+}
+
+/* the BIOS unpacks the compressed assets, so do the same here - the header
+ * word holds the type in its low byte and the unpacked size above that */
+void lz77_uncomp_vram(const void* source, volatile void* dest) {
+    const unsigned char* in = (const unsigned char*) source;
+    unsigned char* out = (unsigned char*) dest;
+    unsigned int size = (in[1] | (in[2] << 8) | (in[3] << 16));
+    unsigned int length = 0;
+    in += 4;
+
+    while (length < size) {
+        /* each flag byte says which of the next 8 blocks are references */
+        unsigned char flags = *in++;
+        for (int bit = 7; bit >= 0 && length < size; bit--) {
+            if (flags & (1 << bit)) {
+                unsigned int count = (in[0] >> 4) + 3;
+                unsigned int distance = (((in[0] & 0xf) << 8) | in[1]) + 1;
+                in += 2;
+                for (unsigned int i = 0; i < count && length < size; i++, length++) {
+                    out[length] = out[length - distance];
+                }
+            } else {
+                out[length++] = *in++;
+            }
+        }
+    }
+}
+
+void rl_uncomp_vram(const void* source, volatile void* dest) {
+    const unsigned char* in = (const unsigned char*) source;
+    unsigned char* out = (unsigned char*) dest;
+    unsigned int size = (in[1] | (in[2] << 8) | (in[3] << 16));
+    unsigned int length = 0;
+    in += 4;
+
+    while (length < size) {
+        unsigned char flag = *in++;
+        if (flag & 0x80) {
+            /* one byte repeated */
+            unsigned int count = (flag & 0x7f) + 3;
+            memset(out + length, *in++, count);
+            length += count;
+        } else {
+            /* bytes copied as they are */
+            unsigned int count = (flag & 0x7f) + 1;
+            memcpy(out + length, in, count);
+            in += count;
+            length += count;
+        }
+    }
+}
+
+int host_bench_enabled = 0;
+unsigned long long host_bench_ns[NUM_BENCH_SECTIONS];
+unsigned long long host_bench_calls[NUM_BENCH_SECTIONS];
+static unsigned long long host_bench_start[NUM_BENCH_SECTIONS];
+
+unsigned long long host_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+void host_bench_begin(enum BenchSection section) {
+    if (host_bench_enabled) {
+        host_bench_start[section] = host_clock();
+    }
+}
+
+void host_bench_end(enum BenchSection section) {
+    if (host_bench_enabled) {
+        host_bench_ns[section] += host_clock() - host_bench_start[section];
+        host_bench_calls[section]++;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * host.h
+ * stand-ins for the GBA hardware when the game is built for a computer
+ */
+
+#pragma once
+#ifndef HOST_H
+#define HOST_H
+
+/* the sections the benchmark keeps separate timings for */
+#include "profile.h"
+
+/* the size of each emulated memory region, in halfwords */
+#define HOST_IWRAM_SIZE 0x4000
+#define HOST_IO_SIZE 0x200
+#define HOST_PALETTE_SIZE 0x200
+#define HOST_VRAM_SIZE 0xc000
+#define HOST_OAM_SIZE 0x200
+
+/* the save memory is 8 bits wide, so its size is in bytes */
+#define HOST_SRAM_SIZE 0x8000
+
+/* the memory regions which the hardware addresses point into */
+extern unsigned short host_iwram[HOST_IWRAM_SIZE];
+extern unsigned short host_io[HOST_IO_SIZE];
+extern unsigned short host_palette[HOST_PALETTE_SIZE];
+extern unsigned short host_vram[HOST_VRAM_SIZE];
+extern unsigned short host_oam[HOST_OAM_SIZE];
+extern unsigned char host_sram[HOST_SRAM_SIZE];
+
+/* clear all of the emulated memory but the save memory, which keeps its
+ * contents like the battery backed chip does - the scanline counter is left
+ * inside of vblank so that waiting for it returns right away */
+void host_reset();
+
+/* carry out the transfer described by a DMA control word */
+void host_dma(void* dest, const void* source, unsigned int control);
+
+/* set up a channel to copy at each hblank, as described by a DMA control word,
+ * or stop it with a control of 0 - the host keeps the addresses itself, as
+ * pointers don't fit the registers */
+void host_hblank_dma(int channel, void* dest, const void* source, unsigned int control);
+
+/* the host has no interrupt vector, so the function the vcount interrupt runs
+ * is set here */
+extern void (*host_vcount_handler)();
+
+/* run what happens while a line is drawn: the vcount interrupt as it starts,
+ * if it is turned on and matches, then the copies at its hblank - returns
+ * whether any of those wrote to OAM */
+int host_line(int line);
+
+/* the host has no interrupts, so waiting for vblank just counts one */
+void vblank_intr_wait();
+
+/* set which buttons are held down, a 1 bit means pressed (the hardware register
+ * uses 0 for pressed, this takes care of flipping them) */
+void host_set_buttons(unsigned short pressed);
+
+/* whether the section timers are running, and the total nanoseconds and number
+ * of times each section has been timed */
+extern int host_bench_enabled;
+extern unsigned long long host_bench_ns[NUM_BENCH_SECTIONS];
+extern unsigned long long host_bench_calls[NUM_BENCH_SECTIONS];
+
+/* a monotonic clock in nanoseconds */
+unsigned long long host_clock();
+
+/* mark the start and end of a timed section */
+void host_bench_begin(enum BenchSection section);
+void host_bench_end(enum BenchSection section);
+
+#define BENCH_BEGIN(section) host_bench_begin(section)
+#define BENCH_END(section) host_bench_end(section)
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * input.c
+ * the keypad sampled once a frame, which can be recorded to SRAM and played back
+ */
+
+#include "input.h"
+
+/* the bytes at the start of a log */
+static const unsigned char input_magic[4] = {'K', 'E', 'Y', 'S'};
+
+void input_update(struct Input* input, unsigned short keys) {
+    unsigned short changed = keys ^ input->held;
+    input->pressed = changed & keys;
+    input->released = changed & input->held;
+    input->held = keys;
+}
+
+/* read and write the little endian length after the magic */
+static int input_log_length(struct InputLog* log) {
+    return log->data[4] | (log->data[5] << 8) | (log->data[6] << 16) | (log->data[7] << 24);
+}
+
+static void input_log_set_length(struct InputLog* log, int length) {
+    log->length = length;
+    log->data[4] = length;
+    log->data[5] = length >> 8;
+    log->data[6] = length >> 16;
+    log->data[7] = length >> 24;
+}
+
+void input_log_init(struct InputLog* log, volatile unsigned char* data, int size) {
+    log->data = data;
+    log->size = size;
+    log->mode = INPUT_LIVE;
+    log->length = 0;
+    log->position = 0;
+    log->keys = 0;
+    log->run = 0;
+    log->frames = 0;
+    log->full = 0;
+}
+
+void input_record(struct InputLog* log) {
+    for (int i = 0; i < 4; i++) {
+        log->data[i] = input_magic[i];
+    }
+    input_log_set_length(log, 0);
+    log->mode = INPUT_RECORD;
+    log->run = 0;
+    log->frames = 0;
+    log->full = 0;
+}
+
+int input_replay(struct InputLog* log) {
+    for (int i = 0; i < 4; i++) {
+        if (log->data[i] != input_magic[i]) {
+            return 0;
+        }
+    }
+
+    int length = input_log_length(log);
+    if (length < 0 || length > log->size - INPUT_LOG_HEADER) {
+        return 0;
+    }
+
+    log->length = length;
+    log->mode = INPUT_REPLAY;
+    log->position = 0;
+    log->run = 0;
+    log->frames = 0;
+    return 1;
+}
+
+/* add a frame of keys to the log - the run being recorded is always written
+ * out, so the log is whole whenever the power goes */
+static void input_log_add(struct InputLog* log, unsigned short keys) {
+    volatile unsigned char* runs = log->data + INPUT_LOG_HEADER;
+
+    if (log->run > 0 && keys == log->keys && log->run < INPUT_LOG_MAX_RUN) {
+        log->run++;
+        runs[log->length - INPUT_LOG_RUN] = log->run;
+    } else {
+        if (INPUT_LOG_HEADER + log->length + INPUT_LOG_RUN > log->size) {
+            /* keep what fits, and stop there */
+            log->full = 1;
+            log->mode = INPUT_LIVE;
+            return;
+        }
+        log->keys = keys;
+        log->run = 1;
+        runs[log->length] = 1;
+        runs[log->length + 1] = keys;
+        runs[log->length + 2] = keys >> 8;
+        input_log_set_length(log, log->length + INPUT_LOG_RUN);
+    }
+    log->frames++;
+}
+
+unsigned short input_log_step(struct InputLog* log, unsigned short live) {
+    if (log->mode == INPUT_RECORD) {
+        input_log_add(log, live);
+    } else if (log->mode == INPUT_REPLAY) {
+        /* move on to the next run once this one is used up */
+        if (log->run == 0) {
+            if (log->position + INPUT_LOG_RUN > log->length) {
+                log->mode = INPUT_LIVE;
+                return live;
+            }
+            volatile unsigned char* run = log->data + INPUT_LOG_HEADER + log->position;
+            log->run = run[0];
+            log->keys = run[1] | (run[2] << 8);
+            log->position += INPUT_LOG_RUN;
+
+            /* a run of no frames means the log is broken */
+            if (log->run == 0) {
+                log->mode = INPUT_LIVE;
+                return live;
+            }
+        }
+        log->run--;
+        log->frames++;
+        return log->keys;
+    }
+    return live;
+}
@@ -0,0 +1,73 @@
+/*
+ * input.h
+ * the keypad sampled once a frame, which can be recorded to SRAM and played back
+ */
+
+#pragma once
+#ifndef INPUT_H
+#define INPUT_H
+
+/* the 10 keys of the keypad register */
+#define INPUT_KEYS 0x3ff
+
+/* the keys for one frame - a 1 bit means the key is down, pressed and released
+ * are the keys which went down or came up since the frame before */
+struct Input {
+    unsigned short held;
+    unsigned short pressed;
+    unsigned short released;
+};
+
+/* what a log is doing with the keys each frame */
+#define INPUT_LIVE 0
+#define INPUT_RECORD 1
+#define INPUT_REPLAY 2
+
+/* the log starts with 4 bytes saying it is one and 4 giving the bytes of runs
+ * which follow, and each run is 3 bytes - the frames it lasts (1 to 255) and the
+ * keys, low byte first - SRAM is only 8 bits wide, so it is all bytes */
+#define INPUT_LOG_HEADER 8
+#define INPUT_LOG_RUN 3
+#define INPUT_LOG_MAX_RUN 255
+
+/* a run length coded log of the keys held each frame */
+struct InputLog {
+    volatile unsigned char* data;
+    int size;
+
+    int mode;
+
+    /* the bytes of runs in the log, including the one being recorded */
+    int length;
+
+    /* where the next run is read from when replaying */
+    int position;
+
+    /* the keys of the run being recorded or replayed, and its frames so far
+     * or left to go */
+    unsigned short keys;
+    int run;
+
+    /* frames recorded or replayed, and whether recording ran out of room */
+    unsigned long frames;
+    int full;
+};
+
+/* work out a frame's edges from the keys held in it */
+void input_update(struct Input* input, unsigned short keys);
+
+/* use size bytes at data for a log, leaving what is there alone */
+void input_log_init(struct InputLog* log, volatile unsigned char* data, int size);
+
+/* start a new recording, over any log already there */
+void input_record(struct InputLog* log);
+
+/* start playing the log back, returns 0 if there is no log to play */
+int input_replay(struct InputLog* log);
+
+/* the keys to use for this frame - the live ones, which are added to the log
+ * while recording, or the log's while replaying (once it runs out, the live
+ * keys are used again) */
+unsigned short input_log_step(struct InputLog* log, unsigned short live);
+
+#endif
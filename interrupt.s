@@ -0,0 +1,29 @@
+.global interrupt_handler
+.global vblank_intr_wait
+
+@ called by the BIOS in ARM mode whenever an enabled interrupt fires
+interrupt_handler:
+	mov r0, #0x4000000
+	add r3, r0, #0x200
+	ldr r1, [r3]		@ IE in the low half, IF in the high half
+	and r1, r1, r1, lsr #16	@ the interrupts which are enabled and pending
+	strh r1, [r3, #2]	@ writing a 1 to IF acknowledges them
+	ldrh r2, [r0, #-8]	@ the BIOS copy of IF, which IntrWait checks
+	orr r2, r2, r1
+	strh r2, [r0, #-8]
+	tst r1, #1
+	beq .vcount
+	ldr r2, =vblank_count	@ count every vblank
+	ldr r3, [r2]
+	add r3, r3, #1
+	str r3, [r2]
+.vcount:
+	tst r1, #4		@ the vcount interrupt moves the sprite multiplexer on,
+	ldrne r2, =sprite_mux_line	@ which goes straight back to the BIOS
+	bxne r2
+	mov pc, lr
+
+@ halt the CPU until the next vblank interrupt
+vblank_intr_wait:
+	swi 0x50000
+	mov pc, lr
@@ -0,0 +1,98 @@
+/*
+ * map.c
+ * collision information for the tile map
+ */
+
+#include "map.h"
+
+/* the forest tiles which can't be walked through, numbered as they are after
+ * assetconv merges repeated tiles (it stops if that would renumber one of these) */
+const unsigned char tile_properties[1024] = {
+    [1] = TILE_SOLID,
+    [2] = TILE_SOLID,
+    [5] = TILE_SOLID,
+    [6] = TILE_SOLID
+};
+
+void collision_map_build(unsigned int* rows, unsigned int* columns,
+        const unsigned short* tilemap, int width, int height) {
+    int row_words = width >> 5;
+    int column_words = height >> 5;
+
+    for (int i = 0; i < height * row_words; i++) {
+        rows[i] = 0;
+    }
+    for (int i = 0; i < width * column_words; i++) {
+        columns[i] = 0;
+    }
+
+    /* set the bit for each solid tile in both its row and its column - the
+     * flip and palette bits of the map entry don't matter here */
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned short entry = tilemap[map_index(x, y, width, height)];
+            if (tile_properties[entry & 0x3ff] & TILE_SOLID) {
+                rows[y * row_words + (x >> 5)] |= 1u << (x & 31);
+                columns[x * column_words + (y >> 5)] |= 1u << (y & 31);
+            }
+        }
+    }
+}
+
+/* the 32 bits starting at bit first of a line of length bits which wraps around */
+static unsigned int map_line_bits(const unsigned int* line, int length, int first) {
+    int shift = first & 31;
+    int word = first >> 5;
+
+    /* the bits from first on, topped up from the next word (wrapping back to
+     * the start of the line) if they cross a word */
+    unsigned int bits = line[word] >> shift;
+    if (shift != 0) {
+        int next = (word + 1) & ((length >> 5) - 1);
+        bits |= line[next] << (32 - shift);
+    }
+    return bits;
+}
+
+/* are any of count (up to 32) bits set starting at bit first of a line of
+ * length bits which wraps around */
+static int map_line_blocked(const unsigned int* line, int length, int first, int count) {
+    unsigned int mask = (count >= 32) ? 0xffffffff : (1u << count) - 1;
+    return (map_line_bits(line, length, first) & mask) != 0;
+}
+
+unsigned int map_row_bits(const struct CollisionMap* map, int x, int y) {
+    int row = y & (map->height - 1);
+    return map_line_bits(map->rows + row * (map->width >> 5), map->width,
+            x & (map->width - 1));
+}
+
+int map_blocked(const struct CollisionMap* map, int x, int y, int w, int h) {
+    /* the range of tiles the box covers */
+    int left = x >> 3;
+    int top = y >> 3;
+    int across = ((x + w - 1) >> 3) - left + 1;
+    int down = ((y + h - 1) >> 3) - top + 1;
+
+    /* wrap the top left corner onto the map */
+    left &= map->width - 1;
+    top &= map->height - 1;
+
+    /* go along whichever way the box is longer, so a 16 pixel edge is one test */
+    if (across >= down) {
+        for (int i = 0; i < down; i++) {
+            int row = (top + i) & (map->height - 1);
+            if (map_line_blocked(map->rows + row * (map->width >> 5), map->width, left, across)) {
+                return 1;
+            }
+        }
+    } else {
+        for (int i = 0; i < across; i++) {
+            int column = (left + i) & (map->width - 1);
+            if (map_line_blocked(map->columns + column * (map->height >> 5), map->height, top, down)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * map.h
+ * collision information for the tile map
+ */
+
+#pragma once
+#ifndef MAP_H
+#define MAP_H
+
+/* the properties a tile can have */
+#define TILE_SOLID (1 << 0)
+
+/* the properties of each of the 1024 tile numbers a map entry can use */
+extern const unsigned char tile_properties[1024];
+
+/* one bit per tile saying whether it is solid - each row of tiles is packed
+ * into words, and so is each column, so that a run of tiles along either
+ * direction can be tested with a word load and a mask. the bits are kept
+ * elsewhere (for a map that never changes they can be built ahead of time and
+ * left in the ROM) */
+struct CollisionMap {
+    /* the size in tiles, these must be powers of two of at least 32 */
+    int width;
+    int height;
+
+    /* height rows of width / 32 words, and width columns of height / 32 words */
+    const unsigned int* rows;
+    const unsigned int* columns;
+};
+
+/* where the entry for tile (x, y) is in a width by height background map - the
+ * maps bigger than 32x32 are made of 32x32 screen blocks one after the other,
+ * left to right then top to bottom. the sizes are powers of two so wrapping is
+ * a mask, and when they are constants the whole thing folds down to a few
+ * shifts and masks with no branches */
+static inline int map_index(int x, int y, int width, int height) {
+    x &= width - 1;
+    y &= height - 1;
+    int block = (y >> 5) * (width >> 5) + (x >> 5);
+    return block * 1024 + (y & 31) * 32 + (x & 31);
+}
+
+/* make the accessors for one background size: map_index_WxH is map_index with
+ * the size fixed, and map_lookup_many_WxH finds the entries under count pixels
+ * of the map in one go, each moved by (dx, dy) first */
+#define MAP_LOOKUP(width, height) \
+    static inline int map_index_##width##x##height(int x, int y) { \
+        return map_index(x, y, width, height); \
+    } \
+    static inline void map_lookup_many_##width##x##height( \
+            const unsigned short* map, const int* x, const int* y, int count, \
+            int dx, int dy, unsigned short* tiles) { \
+        for (int i = 0; i < count; i++) { \
+            tiles[i] = map[map_index((x[i] + dx) >> 3, (y[i] + dy) >> 3, width, height)]; \
+        } \
+    }
+
+/* one set for each size of regular background */
+MAP_LOOKUP(32, 32)
+MAP_LOOKUP(64, 32)
+MAP_LOOKUP(32, 64)
+MAP_LOOKUP(64, 64)
+
+/* work out the collision bits for a width by height map, filling in rows
+ * (height * width / 32 words) and columns (width * height / 32 words) */
+void collision_map_build(unsigned int* rows, unsigned int* columns,
+        const unsigned short* tilemap, int width, int height);
+
+/* the solid bits of the 32 tiles along row y starting from tile x, wrapping
+ * around the map, with tile x in the lowest bit */
+unsigned int map_row_bits(const struct CollisionMap* map, int x, int y);
+
+/* is any part of a w by h pixel box at (x, y) over a solid tile? coordinates
+ * are in map pixels and wrap around like the background does */
+int map_blocked(const struct CollisionMap* map, int x, int y, int w, int h);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * physics.c
+ * fixed point motion for the player, bullets and enemies
+ */
+
+#include "physics.h"
+
+/* scale a velocity by friction, rounding towards zero so it always settles */
+static int physics_friction(int v, int friction) {
+    if (v < 0) {
+        return -((-v * friction) >> 8);
+    }
+    return (v * friction) >> 8;
+}
+
+void physics_accelerate(int* vx, int* vy, const int* ax, const int* ay, int friction,
+        const unsigned char* live, int count) {
+    for (int n = 0; n < count; n++) {
+        int i = live[n];
+        vx[i] = physics_friction(vx[i] + ax[i], friction);
+        vy[i] = physics_friction(vy[i] + ay[i], friction);
+    }
+}
+
+void physics_move(int* x, int* y, const int* vx, const int* vy,
+        const unsigned char* live, int count) {
+    for (int n = 0; n < count; n++) {
+        int i = live[n];
+        x[i] += vx[i];
+        y[i] += vy[i];
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ * physics.h
+ * fixed point motion for the player, bullets and enemies
+ */
+
+#pragma once
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+/* positions, velocities and accelerations are fixed point numbers with 8 bits
+ * after the point, so 256 is one pixel (or one pixel per frame) */
+#define FIXED_SHIFT 8
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+/* convert between whole pixels and fixed point - the camera can go above and
+ * left of the world, so positions can be negative and are multiplied up */
+#define FIXED(n) ((n) * FIXED_ONE)
+#define FIXED_PIXELS(f) ((f) >> FIXED_SHIFT)
+
+/* friction is the part of its speed a body keeps each frame, out of 256 */
+#define FRICTION_NONE 256
+
+/* speed up count bodies by their accelerations, then slow them by friction -
+ * the bodies are the slots listed in live */
+void physics_accelerate(int* vx, int* vy, const int* ax, const int* ay, int friction,
+        const unsigned char* live, int count);
+
+/* move count bodies along their velocities */
+void physics_move(int* x, int* y, const int* vx, const int* vy,
+        const unsigned char* live, int count);
+
+#endif
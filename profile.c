@@ -0,0 +1,102 @@
+/*
+ * profile.c
+ * the hardware timer profiler, which is only built into a profile build
+ */
+
+#ifdef PROFILE
+
+#include "gba.h"
+#include "profile.h"
+
+/* timer 0 counts every cycle, and timer 1 counts up each time it overflows,
+ * so together they make a 32 bit cycle counter */
+volatile unsigned short* timer0_data = (volatile unsigned short*) IO_ADDRESS(0x100);
+volatile unsigned short* timer0_control = (volatile unsigned short*) IO_ADDRESS(0x102);
+volatile unsigned short* timer1_data = (volatile unsigned short*) IO_ADDRESS(0x104);
+volatile unsigned short* timer1_control = (volatile unsigned short*) IO_ADDRESS(0x106);
+
+/* the bits of a timer control register */
+#define TIMER_CASCADE (1 << 2)
+#define TIMER_ENABLE (1 << 7)
+
+struct ProfileRecord profile_log[PROFILE_LOG_SIZE];
+unsigned int profile_log_count = 0;
+
+/* the counter when each section last began, and its cycles so far this frame */
+static unsigned int profile_start[NUM_BENCH_SECTIONS];
+static unsigned int profile_cycles[NUM_BENCH_SECTIONS];
+
+/* the cycles of each section in each frame of the window */
+static unsigned int profile_samples[PROFILE_WINDOW][NUM_BENCH_SECTIONS];
+static unsigned int profile_frames = 0;
+
+void profile_init() {
+    *timer0_control = 0;
+    *timer1_control = 0;
+
+    /* a timer loads its reload value when it is turned on */
+    *timer0_data = 0;
+    *timer1_data = 0;
+    *timer1_control = TIMER_CASCADE | TIMER_ENABLE;
+    *timer0_control = TIMER_ENABLE;
+}
+
+/* read both halves of the counter - if timer 0 wrapped in between the reads,
+ * read it again */
+static unsigned int profile_now() {
+    unsigned int high = *timer1_data;
+    unsigned int low = *timer0_data;
+    if (*timer1_data != high) {
+        high = *timer1_data;
+        low = *timer0_data;
+    }
+    return (high << 16) | low;
+}
+
+void profile_begin(enum BenchSection section) {
+    profile_start[section] = profile_now();
+}
+
+void profile_end(enum BenchSection section) {
+    profile_cycles[section] += profile_now() - profile_start[section];
+}
+
+/* add the stats of a section over the last window to the log */
+static void profile_record(int section) {
+    unsigned int min = 0xffffffff, max = 0, total = 0;
+    for (int f = 0; f < PROFILE_WINDOW; f++) {
+        unsigned int cycles = profile_samples[f][section];
+        if (cycles < min) {
+            min = cycles;
+        }
+        if (cycles > max) {
+            max = cycles;
+        }
+        total += cycles;
+    }
+
+    struct ProfileRecord* record = &profile_log[profile_log_count % PROFILE_LOG_SIZE];
+    record->frame = profile_frames;
+    record->section = section;
+    record->min = min;
+    record->avg = total / PROFILE_WINDOW;
+    record->max = max;
+    profile_log_count++;
+}
+
+void profile_frame(int log) {
+    int slot = profile_frames % PROFILE_WINDOW;
+    for (int s = 0; s < NUM_BENCH_SECTIONS; s++) {
+        profile_samples[slot][s] = profile_cycles[s];
+        profile_cycles[s] = 0;
+    }
+    profile_frames++;
+
+    if (log && slot == PROFILE_WINDOW - 1) {
+        for (int s = 0; s < NUM_BENCH_SECTIONS; s++) {
+            profile_record(s);
+        }
+    }
+}
+
+#endif
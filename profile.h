@@ -0,0 +1,56 @@
+/*
+ * profile.h
+ * the timed sections of a frame, and the hardware timer profiler which times
+ * them on the GBA in a profile build (-DPROFILE)
+ */
+
+#pragma once
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/* the parts of a frame which get timed, on the host by the benchmark and on the
+ * GBA by the profiler */
+enum BenchSection {
+    BENCH_PLAYER_UPDATE,
+    BENCH_SLIME_MOVE,
+    BENCH_BULLET_CHECK,
+    BENCH_COLLISION_CHECK,
+    BENCH_CALC_WAVE,
+    BENCH_SPRITE_UPDATE,
+    BENCH_MAP_STREAM,
+    BENCH_DMA_FLUSH,
+    NUM_BENCH_SECTIONS
+};
+
+/* the frames the min, average and max are taken over */
+#define PROFILE_WINDOW 64
+
+/* the records kept in the log before the oldest are written over */
+#define PROFILE_LOG_SIZE 128
+
+/* the cycles one section took per frame over a window of frames */
+struct ProfileRecord {
+    unsigned int frame;
+    unsigned int section;
+    unsigned int min;
+    unsigned int avg;
+    unsigned int max;
+};
+
+/* the log, to be read out with a debugger - profile_log_count keeps counting
+ * past the end, so the newest record is at (count - 1) % PROFILE_LOG_SIZE */
+extern struct ProfileRecord profile_log[PROFILE_LOG_SIZE];
+extern unsigned int profile_log_count;
+
+/* start timer 0 counting cycles, with timer 1 counting its overflows */
+void profile_init();
+
+/* mark the start and end of a section, which can run more than once a frame */
+void profile_begin(enum BenchSection section);
+void profile_end(enum BenchSection section);
+
+/* close off a frame - at the end of each window, log the stats of every
+ * section if log is set */
+void profile_frame(int log);
+
+#endif
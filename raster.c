@@ -0,0 +1,67 @@
+/*
+ * raster.c
+ * per line effects fed in by DMA at every hblank
+ */
+
+#include "gba.h"
+#include "dma.h"
+#include "raster.h"
+
+void raster_init(struct Raster* raster) {
+    raster->frames_total = 0;
+    raster->built_total = 0;
+    raster_clear(raster);
+}
+
+void raster_clear(struct Raster* raster) {
+    for (int index = 0; index < RASTER_EFFECTS; index++) {
+        raster_set(raster, index, 0, 0);
+    }
+}
+
+void raster_set(struct Raster* raster, int index, volatile void* dest, int units) {
+    struct RasterEffect* effect = &raster->effects[index];
+    effect->dest = dest;
+    effect->units = units;
+    effect->front = 0;
+    effect->built = 0;
+    effect->shown = 0;
+}
+
+unsigned short* raster_build(struct Raster* raster, int index) {
+    struct RasterEffect* effect = &raster->effects[index];
+    effect->built = 1;
+    raster->built_total++;
+    return effect->tables[effect->front ^ 1];
+}
+
+void raster_show(struct Raster* raster) {
+    int on = 0;
+    for (int index = 0; index < RASTER_EFFECTS; index++) {
+        struct RasterEffect* effect = &raster->effects[index];
+        dma_hblank_stop(DMA_HBLANK_RASTER + index);
+
+        if (effect->built) {
+            effect->front ^= 1;
+            effect->built = 0;
+            effect->shown = 1;
+        }
+        if (!effect->shown || !effect->dest) {
+            continue;
+        }
+
+        /* the first line's values go in now, and the copy at each hblank
+         * brings in the next line's, the spare at the end giving the first
+         * line's back after the last */
+        unsigned short* table = effect->tables[effect->front];
+        volatile unsigned short* dest = (volatile unsigned short*) effect->dest;
+        for (int unit = 0; unit < effect->units; unit++) {
+            dest[unit] = table[unit];
+            table[RASTER_LINES * effect->units + unit] = table[unit];
+        }
+        dma_hblank_registers(DMA_HBLANK_RASTER + index, effect->dest, table + effect->units,
+                effect->units);
+        on = 1;
+    }
+    raster->frames_total += on;
+}
@@ -0,0 +1,65 @@
+/*
+ * raster.h
+ * effects which change display registers or palette entries from one line of
+ * the screen to the next, with a table of values for each line fed in by DMA
+ * at every hblank, so drawing them costs the CPU nothing
+ */
+
+#pragma once
+#ifndef RASTER_H
+#define RASTER_H
+
+/* the lines of the screen */
+#define RASTER_LINES 160
+
+/* the effects which can run at once, each on its own DMA channel */
+#define RASTER_EFFECTS 2
+
+/* the most halfwords an effect writes each line, such as both scrolls of a
+ * background or both edges of a window */
+#define RASTER_UNITS 2
+
+/* an effect writing units halfwords to dest at the start of each line - a
+ * table is built while the other is shown, and has a spare line on the end
+ * which puts the first line's values back as the last one finishes */
+struct RasterEffect {
+    volatile void* dest;
+    int units;
+    unsigned short tables[2][(RASTER_LINES + 1) * RASTER_UNITS];
+
+    /* the table shown, whether the other has been built since it was shown,
+     * and whether any has been shown */
+    int front;
+    int built;
+    int shown;
+};
+
+/* the effects, which start once they have a table */
+struct Raster {
+    struct RasterEffect effects[RASTER_EFFECTS];
+
+    /* the frames shown with any effect on, and the tables built, in total */
+    unsigned long frames_total;
+    unsigned long built_total;
+};
+
+/* set up with every effect off, clearing the counts */
+void raster_init(struct Raster* raster);
+
+/* turn every effect off, keeping the counts */
+void raster_clear(struct Raster* raster);
+
+/* aim effect index at units halfwords of registers or palette entries from
+ * dest, or turn it off with a dest of 0 - either way it stays off until a
+ * table is built for it */
+void raster_set(struct Raster* raster, int index, volatile void* dest, int units);
+
+/* the table to fill in with effect index's values for each line, units
+ * halfwords a line - it is shown from the next raster_show on */
+unsigned short* raster_build(struct Raster* raster, int index);
+
+/* show the tables built since the last call and start feeding in every
+ * effect's table from the top, this must be called during vblank */
+void raster_show(struct Raster* raster);
+
+#endif
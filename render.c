@@ -0,0 +1,422 @@
+/*
+ * render.c
+ * draws what the emulated display registers, VRAM and OAM would show, so the
+ * host build can check the game's frames
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "host.h"
+#include "map.h"
+#include "render.h"
+
+/* halfword offsets of the display registers */
+#define RENDER_DISPLAY_CONTROL (0x000 / 2)
+#define RENDER_BG_CONTROL (0x008 / 2)
+#define RENDER_BG_SCROLL (0x010 / 2)
+
+/* the bits of the display control register */
+#define RENDER_FORCED_BLANK (1 << 7)
+#define RENDER_SPRITE_1D (1 << 6)
+#define RENDER_BG_ENABLE (1 << 8)
+#define RENDER_SPRITE_ENABLE (1 << 12)
+
+/* the bytes of VRAM the backgrounds can use, the sprite tiles start after them */
+#define RENDER_BG_VRAM 0x10000
+#define RENDER_SPRITE_VRAM 0x10000
+
+/* the tiles a line of a background can touch, for looking them all up in one go -
+ * the left edge of each measured from the first, which are all on the line */
+#define RENDER_LINE_TILES (RENDER_WIDTH / 8 + 1)
+static const int render_tile_x[RENDER_LINE_TILES] = {
+    0, 8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96, 104, 112, 120,
+    128, 136, 144, 152, 160, 168, 176, 184, 192, 200, 208, 216, 224, 232, 240
+};
+static const int render_tile_y[RENDER_LINE_TILES];
+
+/* a priority lower than any layer, for pixels no sprite covers */
+#define RENDER_NO_SPRITE 4
+
+/* eight pixels at once, so the compiler can fill spans with vector stores */
+typedef unsigned short render_pixels __attribute__((vector_size(16)));
+
+/* a line has a tile's worth of spare pixels on both sides, so the tiles which
+ * are only partly on the screen can be drawn whole */
+#define RENDER_PAD 8
+
+/* the width and height of each sprite shape (square, wide, tall) and size */
+static const unsigned char render_sprite_sizes[3][4][2] = {
+    {{8, 8}, {16, 16}, {32, 32}, {64, 64}},
+    {{16, 8}, {32, 8}, {32, 16}, {64, 32}},
+    {{8, 16}, {8, 32}, {16, 32}, {32, 64}}
+};
+
+/* the colors and priorities of the front sprite at each pixel of a line, and
+ * the part of the line they cover */
+static unsigned short render_sprite_color[RENDER_WIDTH];
+static unsigned char render_sprite_priority[RENDER_WIDTH];
+static int render_sprite_left, render_sprite_right;
+
+/* the sprites on each line, from the back (the highest numbered) to the front */
+static unsigned char render_line_sprites[RENDER_HEIGHT][128];
+static unsigned char render_line_count[RENDER_HEIGHT];
+
+/* draw the opaque pixels of a text background's line over line, which has to
+ * have RENDER_PAD pixels to spare on each side */
+static void render_bg_line(int bg, int y, unsigned short* line) {
+    const unsigned char* vram = (const unsigned char*) host_vram;
+    unsigned short control = host_io[RENDER_BG_CONTROL + bg];
+    int xscroll = host_io[RENDER_BG_SCROLL + bg * 2] & 0x1ff;
+    int yscroll = host_io[RENDER_BG_SCROLL + bg * 2 + 1] & 0x1ff;
+
+    int chars = ((control >> 2) & 3) * 0x4000;
+    int color256 = control & 0x80;
+    const unsigned short* screen = host_vram + ((control >> 8) & 31) * 0x400;
+
+    /* the entries under the line, with the accessors for the background's size -
+     * sizes 1 and 3 are two screen blocks wide, and 2 and 3 two high */
+    int map_y = y + yscroll;
+    int left = xscroll & ~7;
+    unsigned short entries[RENDER_LINE_TILES];
+    switch (control >> 14) {
+        case 0:
+            map_lookup_many_32x32(screen, render_tile_x, render_tile_y, RENDER_LINE_TILES,
+                    left, map_y, entries);
+            break;
+        case 1:
+            map_lookup_many_64x32(screen, render_tile_x, render_tile_y, RENDER_LINE_TILES,
+                    left, map_y, entries);
+            break;
+        case 2:
+            map_lookup_many_32x64(screen, render_tile_x, render_tile_y, RENDER_LINE_TILES,
+                    left, map_y, entries);
+            break;
+        default:
+            map_lookup_many_64x64(screen, render_tile_x, render_tile_y, RENDER_LINE_TILES,
+                    left, map_y, entries);
+            break;
+    }
+
+    /* a tile at a time, the first and last only partly on the screen */
+    for (int i = 0, x = -(xscroll & 7); x < RENDER_WIDTH; i++, x += 8) {
+        unsigned short entry = entries[i];
+        int tile = entry & 0x3ff;
+        int flip_x = (entry & 0x400) ? 7 : 0;
+        int r = (map_y & 7) ^ ((entry & 0x800) ? 7 : 0);
+
+        int address = chars + (color256 ? tile * 64 + r * 8 : tile * 32 + r * 4);
+        if (address >= RENDER_BG_VRAM) {
+            continue;
+        }
+        unsigned short* out = line + x;
+
+        if (color256) {
+            const unsigned char* pixels = vram + address;
+            for (int i = 0; i < 8; i++) {
+                int index = pixels[i ^ flip_x];
+                if (index != 0) {
+                    out[i] = host_palette[index];
+                }
+            }
+        } else {
+            /* the row is one word, its low nibble the leftmost pixel */
+            unsigned int pixels;
+            memcpy(&pixels, vram + address, 4);
+            if (pixels == 0) {
+                continue;
+            }
+            const unsigned short* palette = host_palette + (entry >> 12) * 16;
+            int shift = flip_x ? 28 : 0;
+            int step = flip_x ? -4 : 4;
+            for (int i = 0; i < 8; i++, shift += step) {
+                int index = (pixels >> shift) & 15;
+                if (index != 0) {
+                    out[i] = palette[index];
+                }
+            }
+        }
+    }
+}
+
+/* sort the sprites which can be seen onto the lines they cover, from first on */
+static void render_bin_sprites(int first) {
+    memset(render_line_count + first, 0, RENDER_HEIGHT - first);
+
+    for (int i = 127; i >= 0; i--) {
+        unsigned short attribute0 = host_oam[i * 4];
+        unsigned short attribute1 = host_oam[i * 4 + 1];
+
+        /* affine sprites aren't drawn, and without the affine bit, bit 9 hides
+         * the sprite - mode 2 makes it a window rather than something seen */
+        if ((attribute0 & 0x300) != 0 || ((attribute0 >> 10) & 3) >= 2) {
+            continue;
+        }
+        int shape = attribute0 >> 14;
+        if (shape == 3) {
+            continue;
+        }
+        int height = render_sprite_sizes[shape][attribute1 >> 14][1];
+
+        /* the y coordinate wraps around at 256 */
+        for (int row = 0; row < height; row++) {
+            int y = ((attribute0 & 0xff) + row) & 0xff;
+            if (y >= first && y < RENDER_HEIGHT) {
+                render_line_sprites[y][render_line_count[y]++] = i;
+            }
+        }
+    }
+}
+
+/* work out the front sprite at each pixel of a line - the lowest numbered
+ * sprite covers the others whatever their priorities, like the hardware -
+ * returns a bit for each priority with a sprite pixel on the line */
+static int render_sprite_line(int y, int mapping_1d) {
+    const unsigned char* vram = (const unsigned char*) host_vram + RENDER_SPRITE_VRAM;
+    const unsigned short* palette = host_palette + 0x100;
+    int priorities = 0;
+
+    memset(render_sprite_priority, RENDER_NO_SPRITE, sizeof(render_sprite_priority));
+    render_sprite_left = RENDER_WIDTH;
+    render_sprite_right = 0;
+
+    for (int n = 0; n < render_line_count[y]; n++) {
+        int i = render_line_sprites[y][n];
+        unsigned short attribute0 = host_oam[i * 4];
+        unsigned short attribute1 = host_oam[i * 4 + 1];
+        unsigned short attribute2 = host_oam[i * 4 + 2];
+
+        int shape = attribute0 >> 14;
+        int width = render_sprite_sizes[shape][attribute1 >> 14][0];
+        int height = render_sprite_sizes[shape][attribute1 >> 14][1];
+        int row = (y - (attribute0 & 0xff)) & 0xff;
+        if (attribute1 & 0x2000) {
+            row = height - 1 - row;
+        }
+        int left = attribute1 & 0x1ff;
+        if (left >= RENDER_WIDTH) {
+            left -= 512;
+        }
+
+        int color256 = attribute0 & 0x2000;
+        int units = color256 ? 2 : 1;
+        int tile = attribute2 & 0x3ff;
+        int priority = (attribute2 >> 10) & 3;
+        const unsigned short* bank = palette + (color256 ? 0 : (attribute2 >> 12) * 16);
+
+        /* in 1D mapping the rows of tiles follow each other, in 2D they are 32
+         * tiles apart */
+        int row_tile = tile + (row >> 3) * (mapping_1d ? (width / 8) * units : 32);
+
+        int first = left < 0 ? -left : 0;
+        int last = left + width > RENDER_WIDTH ? RENDER_WIDTH - left : width;
+        if (first >= last) {
+            continue;
+        }
+        if (left + first < render_sprite_left) {
+            render_sprite_left = left + first;
+        }
+        if (left + last > render_sprite_right) {
+            render_sprite_right = left + last;
+        }
+
+        for (int px = first; px < last; px++) {
+            int x = left + px;
+            int c = (attribute1 & 0x1000) ? width - 1 - px : px;
+            int unit = (row_tile + (c >> 3) * units) & 0x3ff;
+            const unsigned char* pixels = vram + unit * 32;
+            int index = color256 ? pixels[(row & 7) * 8 + (c & 7)] :
+                (pixels[(row & 7) * 4 + ((c & 7) >> 1)] >> ((c & 1) * 4)) & 15;
+            if (index != 0) {
+                render_sprite_color[x] = bank[index];
+                render_sprite_priority[x] = priority;
+                priorities |= 1 << priority;
+            }
+        }
+    }
+    return priorities;
+}
+
+void render_frame(unsigned short* frame) {
+    static render_pixels line_pixels[(RENDER_PAD + RENDER_WIDTH + RENDER_PAD) / 8];
+    unsigned short* line = (unsigned short*) line_pixels + RENDER_PAD;
+    unsigned short display = host_io[RENDER_DISPLAY_CONTROL];
+
+    /* a forced blank shows white, and only mode 0 is drawn */
+    if ((display & RENDER_FORCED_BLANK) || (display & 7) != 0) {
+        memset(frame, (display & RENDER_FORCED_BLANK) ? 0xff : 0,
+                RENDER_WIDTH * RENDER_HEIGHT * sizeof(unsigned short));
+        return;
+    }
+
+    unsigned short backdrop_color = host_palette[0];
+    render_pixels backdrop = {backdrop_color, backdrop_color, backdrop_color, backdrop_color,
+        backdrop_color, backdrop_color, backdrop_color, backdrop_color};
+
+    if (display & RENDER_SPRITE_ENABLE) {
+        render_bin_sprites(0);
+    }
+
+    for (int y = 0; y < RENDER_HEIGHT; y++) {
+        for (int i = RENDER_PAD / 8; i < (RENDER_PAD + RENDER_WIDTH) / 8; i++) {
+            line_pixels[i] = backdrop;
+        }
+
+        /* the hardware works out a line's sprites while the line before is
+         * drawn, so they come from OAM as it was before that line's hblank */
+        int sprites = 0;
+        if ((display & RENDER_SPRITE_ENABLE) && render_line_count[y] > 0) {
+            sprites = render_sprite_line(y, display & RENDER_SPRITE_1D);
+        }
+
+        /* then anything copied at that hblank shows from this line on for the
+         * registers, and from the next for OAM */
+        if (y > 0 && host_line(y - 1) && (display & RENDER_SPRITE_ENABLE) &&
+                y + 1 < RENDER_HEIGHT) {
+            render_bin_sprites(y + 1);
+        }
+
+        /* paint from the back to the front - BG3 is behind BG0 when their
+         * priorities are the same, and sprites are in front of both */
+        for (int priority = 3; priority >= 0; priority--) {
+            for (int bg = 3; bg >= 0; bg--) {
+                if ((display & (RENDER_BG_ENABLE << bg)) &&
+                        (host_io[RENDER_BG_CONTROL + bg] & 3) == priority) {
+                    render_bg_line(bg, y, line);
+                }
+            }
+            if (sprites & (1 << priority)) {
+                for (int x = render_sprite_left; x < render_sprite_right; x++) {
+                    if (render_sprite_priority[x] == priority) {
+                        line[x] = render_sprite_color[x];
+                    }
+                }
+            }
+        }
+
+        memcpy(frame + y * RENDER_WIDTH, line, RENDER_WIDTH * sizeof(unsigned short));
+    }
+
+    /* finish the last line and go back into vblank */
+    host_line(RENDER_HEIGHT - 1);
+    host_line(RENDER_HEIGHT);
+}
+
+unsigned long long render_hash(const unsigned short* frame) {
+    unsigned long long hash = 0xcbf29ce484222325ull;
+    for (int i = 0; i < RENDER_WIDTH * RENDER_HEIGHT; i += 4) {
+        unsigned long long pixels;
+        memcpy(&pixels, frame + i, 8);
+        hash ^= pixels;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/* the checksum PNG chunks end with */
+static unsigned int render_crc(unsigned int crc, const unsigned char* data, int length) {
+    static unsigned int table[256];
+    if (table[1] == 0) {
+        for (unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+    }
+
+    crc = ~crc;
+    for (int i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void render_put32(unsigned char* out, unsigned int value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+/* write a chunk with its length and checksum around it */
+static void render_chunk(FILE* file, const char* type, const unsigned char* data, int length) {
+    unsigned char word[4];
+    render_put32(word, length);
+    fwrite(word, 1, 4, file);
+
+    unsigned int crc = render_crc(0, (const unsigned char*) type, 4);
+    crc = render_crc(crc, data, length);
+    fwrite(type, 1, 4, file);
+
+    /* IEND has no data at all, not even a pointer to none */
+    if (length > 0) {
+        fwrite(data, 1, length, file);
+    }
+    render_put32(word, crc);
+    fwrite(word, 1, 4, file);
+}
+
+/* the image is small, so it goes into the zlib stream in stored blocks rather
+ * than being compressed */
+int render_png(const char* path, const unsigned short* frame) {
+    /* a filter byte then RGB for each row */
+    enum { ROW = 1 + RENDER_WIDTH * 3, RAW = ROW * RENDER_HEIGHT, BLOCK = 65535 };
+    static unsigned char raw[RAW];
+    static unsigned char zlib[2 + RAW + (RAW / BLOCK + 1) * 5 + 4];
+
+    for (int y = 0; y < RENDER_HEIGHT; y++) {
+        unsigned char* out = raw + y * ROW;
+        *out++ = 0;
+        for (int x = 0; x < RENDER_WIDTH; x++) {
+            unsigned short color = frame[y * RENDER_WIDTH + x];
+            for (int shift = 0; shift < 15; shift += 5) {
+                int c = (color >> shift) & 31;
+                *out++ = (c << 3) | (c >> 2);
+            }
+        }
+    }
+
+    int length = 0;
+    zlib[length++] = 0x78;
+    zlib[length++] = 0x01;
+    for (int start = 0; start < RAW; start += BLOCK) {
+        int size = (RAW - start < BLOCK) ? RAW - start : BLOCK;
+        zlib[length++] = (start + size == RAW) ? 1 : 0;
+        zlib[length++] = size;
+        zlib[length++] = size >> 8;
+        zlib[length++] = ~size;
+        zlib[length++] = ~size >> 8;
+        memcpy(zlib + length, raw + start, size);
+        length += size;
+    }
+
+    unsigned int a = 1, b = 0;
+    for (int i = 0; i < RAW; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    render_put32(zlib + length, (b << 16) | a);
+    length += 4;
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+    fwrite(signature, 1, 8, file);
+
+    /* 8 bit RGB, no interlacing */
+    unsigned char header[13] = {0};
+    render_put32(header, RENDER_WIDTH);
+    render_put32(header + 4, RENDER_HEIGHT);
+    header[8] = 8;
+    header[9] = 2;
+    render_chunk(file, "IHDR", header, 13);
+    render_chunk(file, "IDAT", zlib, length);
+    render_chunk(file, "IEND", NULL, 0);
+
+    return fclose(file) == 0;
+}
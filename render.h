@@ -0,0 +1,27 @@
+/*
+ * render.h
+ * draws what the emulated display registers, VRAM and OAM would show, so the
+ * host build can check the game's frames
+ */
+
+#pragma once
+#ifndef RENDER_H
+#define RENDER_H
+
+#define RENDER_WIDTH 240
+#define RENDER_HEIGHT 160
+
+/* draw a frame in 15 bit BGR, the same as palette memory, from the tiled
+ * backgrounds of mode 0 and the regular sprites - scrolling, flips, both color
+ * modes and priorities are handled, windows, blending, mosaic and affine
+ * sprites are not */
+void render_frame(unsigned short* frame);
+
+/* a 64 bit FNV-1a hash of a frame, taken 4 pixels at a time, for checking
+ * against known good ones */
+unsigned long long render_hash(const unsigned short* frame);
+
+/* write a frame out as a PNG, returns 0 if it can't */
+int render_png(const char* path, const unsigned short* frame);
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * spawn.c
+ * a queue of spawns waiting for their frame
+ */
+
+#include "spawn.h"
+
+/* is event a due before event b */
+static int spawn_before(const struct SpawnEvent* a, const struct SpawnEvent* b) {
+    return a->frame < b->frame || (a->frame == b->frame && a->order < b->order);
+}
+
+void spawn_queue_init(struct SpawnQueue* queue) {
+    queue->fired = 0;
+    queue->dropped = 0;
+    spawn_queue_clear(queue);
+}
+
+void spawn_queue_clear(struct SpawnQueue* queue) {
+    queue->count = 0;
+    queue->frame = 0;
+    queue->order = 0;
+}
+
+void spawn_queue_tick(struct SpawnQueue* queue) {
+    queue->frame++;
+}
+
+int spawn_queue_add(struct SpawnQueue* queue, int delay, int point) {
+    if (queue->count == SPAWN_QUEUE_SIZE) {
+        queue->dropped++;
+        return 0;
+    }
+
+    struct SpawnEvent event;
+    event.frame = queue->frame + delay;
+    event.order = queue->order++;
+    event.point = point;
+
+    /* move the event up from the end of the heap past everything due after it */
+    int slot = queue->count++;
+    while (slot > 0) {
+        int parent = (slot - 1) / 2;
+        if (!spawn_before(&event, &queue->events[parent])) {
+            break;
+        }
+        queue->events[slot] = queue->events[parent];
+        slot = parent;
+    }
+    queue->events[slot] = event;
+    return 1;
+}
+
+int spawn_queue_wave(struct SpawnQueue* queue, const struct SpawnWave* wave) {
+    int lost = 0;
+    for (int i = 0; i < wave->count; i++) {
+        if (!spawn_queue_add(queue, wave->entries[i].delay, wave->entries[i].point)) {
+            lost++;
+        }
+    }
+    return lost;
+}
+
+int spawn_queue_next(struct SpawnQueue* queue, int* point) {
+    if (queue->count == 0 || queue->events[0].frame > queue->frame) {
+        return 0;
+    }
+    *point = queue->events[0].point;
+    queue->fired++;
+
+    /* move the last event down from the front past everything due before it */
+    struct SpawnEvent last = queue->events[--queue->count];
+    int slot = 0;
+    while (1) {
+        int child = slot * 2 + 1;
+        if (child >= queue->count) {
+            break;
+        }
+        if (child + 1 < queue->count &&
+                spawn_before(&queue->events[child + 1], &queue->events[child])) {
+            child++;
+        }
+        if (!spawn_before(&queue->events[child], &last)) {
+            break;
+        }
+        queue->events[slot] = queue->events[child];
+        slot = child;
+    }
+    queue->events[slot] = last;
+    return 1;
+}
@@ -0,0 +1,72 @@
+/*
+ * spawn.h
+ * a queue of spawns waiting for their frame, so nothing waiting to come out
+ * has to be counted down each frame
+ */
+
+#pragma once
+#ifndef SPAWN_H
+#define SPAWN_H
+
+/* the most spawns which can be waiting at once */
+#define SPAWN_QUEUE_SIZE 64
+
+/* a spawn due on a frame at one of the spawn points - order keeps spawns due on
+ * the same frame in the order they were added */
+struct SpawnEvent {
+    unsigned int frame;
+    unsigned int order;
+    unsigned char point;
+};
+
+/* the waiting spawns, kept as a heap with the soonest at the front */
+struct SpawnQueue {
+    struct SpawnEvent events[SPAWN_QUEUE_SIZE];
+    int count;
+
+    /* the current frame, and the order to give the next spawn added */
+    unsigned int frame;
+    unsigned int order;
+
+    /* the spawns which came due, and the ones lost because the queue was full */
+    unsigned long fired;
+    unsigned long dropped;
+};
+
+/* one spawn of a wave, some frames after the wave starts */
+struct SpawnEntry {
+    unsigned short delay;
+    unsigned char point;
+};
+
+/* the spawns which start when the game reaches a wave */
+struct SpawnWave {
+    int wave;
+    const struct SpawnEntry* entries;
+    int count;
+};
+
+/* make a wave from an array of entries */
+#define SPAWN_WAVE(number, entries) \
+    {number, entries, sizeof(entries) / sizeof(entries[0])}
+
+/* set up an empty queue at frame 0 */
+void spawn_queue_init(struct SpawnQueue* queue);
+
+/* empty a queue and go back to frame 0, keeping its counts */
+void spawn_queue_clear(struct SpawnQueue* queue);
+
+/* move on to the next frame */
+void spawn_queue_tick(struct SpawnQueue* queue);
+
+/* add a spawn at a point delay frames from now, returns 0 if the queue is full */
+int spawn_queue_add(struct SpawnQueue* queue, int delay, int point);
+
+/* add every spawn of a wave, returns the number which didn't fit */
+int spawn_queue_wave(struct SpawnQueue* queue, const struct SpawnWave* wave);
+
+/* take the next spawn which is due, returns 0 once there are none - this only
+ * looks at the front of the queue, so it costs nothing while nothing is due */
+int spawn_queue_next(struct SpawnQueue* queue, int* point);
+
+#endif
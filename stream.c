@@ -0,0 +1,128 @@
+/*
+ * stream.c
+ * keeps the part of a large tile map around the camera in a screen block
+ */
+
+#include "stream.h"
+#include "map.h"
+
+/* the area the screen block should hold for a scroll position */
+static int stream_left(int xscroll) {
+    return xscroll >> 3;
+}
+
+static int stream_top(int yscroll) {
+    return (yscroll >> 3) - STREAM_ROWS_ABOVE;
+}
+
+/* the lines of the screen block which get new map lines when the area's edge
+ * moves from first to moved */
+static unsigned int stream_entering(int first, int moved) {
+    int delta = moved - first;
+    if (delta >= STREAM_SIZE || delta <= -STREAM_SIZE) {
+        return 0xffffffff;
+    }
+
+    unsigned int lines = 0;
+    if (delta > 0) {
+        for (int i = first + STREAM_SIZE; i < moved + STREAM_SIZE; i++) {
+            lines |= 1u << (i & (STREAM_SIZE - 1));
+        }
+    } else {
+        for (int i = moved; i < first; i++) {
+            lines |= 1u << (i & (STREAM_SIZE - 1));
+        }
+    }
+    return lines;
+}
+
+/* write the map column which belongs in one column of the screen block */
+static void stream_column(struct MapStream* stream, int column) {
+    int x = stream->left + ((column - stream->left) & (STREAM_SIZE - 1));
+    for (int row = 0; row < STREAM_SIZE; row++) {
+        int y = stream->top + ((row - stream->top) & (STREAM_SIZE - 1));
+        stream->screen[map_index_32x32(column, row)] =
+            stream->tiles[map_index(x, y, stream->width, stream->height)];
+    }
+}
+
+/* write the map row which belongs in one row of the screen block - the 32 tiles
+ * from the left edge run to the end of their 32x32 block of the map and on into
+ * the next, and the first part lands at the right end of the screen block */
+static void stream_row(struct MapStream* stream, int row) {
+    int y = stream->top + ((row - stream->top) & (STREAM_SIZE - 1));
+    int split = stream->left & (STREAM_SIZE - 1);
+    volatile unsigned short* dest = stream->screen + map_index_32x32(0, row);
+
+    const unsigned short* first = &stream->tiles[map_index(stream->left, y,
+            stream->width, stream->height)];
+    for (int i = split; i < STREAM_SIZE; i++) {
+        dest[i] = first[i - split];
+    }
+
+    const unsigned short* second = &stream->tiles[map_index(stream->left + STREAM_SIZE - split,
+            y, stream->width, stream->height)];
+    for (int i = 0; i < split; i++) {
+        dest[i] = second[i];
+    }
+}
+
+void stream_init(struct MapStream* stream, const unsigned short* tiles, int width,
+        int height, volatile unsigned short* screen, int xscroll, int yscroll) {
+    stream->tiles = tiles;
+    stream->width = width;
+    stream->height = height;
+    stream->screen = screen;
+    stream->left = stream_left(xscroll);
+    stream->top = stream_top(yscroll);
+
+    /* the display isn't showing the game yet, so do it all now */
+    if (screen) {
+        for (int column = 0; column < STREAM_SIZE; column++) {
+            stream_column(stream, column);
+        }
+    }
+    stream->dirty_columns = 0;
+    stream->dirty_rows = 0;
+
+    stream->uploaded_last = 0;
+    stream->uploaded_max = 0;
+    stream->uploaded_total = 0;
+}
+
+void stream_update(struct MapStream* stream, int xscroll, int yscroll) {
+    int left = stream_left(xscroll);
+    int top = stream_top(yscroll);
+
+    stream->dirty_columns |= stream_entering(stream->left, left);
+    stream->dirty_rows |= stream_entering(stream->top, top);
+    stream->left = left;
+    stream->top = top;
+}
+
+void stream_draw(struct MapStream* stream) {
+    unsigned int uploaded = 0;
+
+    /* a column or row is written from wherever the area is now, so one marked a
+     * while ago still gets the right tiles */
+    for (int lines = 0; lines < STREAM_BUDGET; lines++) {
+        if (stream->dirty_columns) {
+            int column = __builtin_ctz(stream->dirty_columns);
+            stream->dirty_columns &= stream->dirty_columns - 1;
+            stream_column(stream, column);
+        } else if (stream->dirty_rows) {
+            int row = __builtin_ctz(stream->dirty_rows);
+            stream->dirty_rows &= stream->dirty_rows - 1;
+            stream_row(stream, row);
+        } else {
+            break;
+        }
+        uploaded += STREAM_SIZE;
+    }
+
+    stream->uploaded_last = uploaded;
+    stream->uploaded_total += uploaded;
+    if (uploaded > stream->uploaded_max) {
+        stream->uploaded_max = uploaded;
+    }
+}
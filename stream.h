@@ -0,0 +1,59 @@
+/*
+ * stream.h
+ * keeps the part of a large tile map around the camera in a screen block
+ */
+
+#pragma once
+#ifndef STREAM_H
+#define STREAM_H
+
+/* the screen block holds 32x32 tiles and the screen shows at most 31x21 of
+ * them, so the loaded area starts at the camera's column and a few rows above
+ * it, leaving spare rows on both sides */
+#define STREAM_SIZE 32
+#define STREAM_ROWS_ABOVE 5
+
+/* the most rows and columns written to the screen block in one vblank - the
+ * camera moves under a tile a frame, so normally one of each is the most needed */
+#define STREAM_BUDGET 4
+
+/* a map much bigger than the hardware one, with the area around the camera
+ * copied into a screen block which wraps around - map tile (x, y) always goes
+ * to entry (x % 32, y % 32), so as the camera moves only the columns and rows
+ * coming into view need writing */
+struct MapStream {
+    /* the whole map, laid out in 32x32 blocks as map_index does */
+    const unsigned short* tiles;
+    int width;
+    int height;
+
+    volatile unsigned short* screen;
+
+    /* the map tile at the top left of the area the screen block should hold */
+    int left;
+    int top;
+
+    /* a bit for each column and row of the screen block still to be written */
+    unsigned int dirty_columns;
+    unsigned int dirty_rows;
+
+    /* the entries written at the last vblank, the most at any one, and in total */
+    unsigned int uploaded_last;
+    unsigned int uploaded_max;
+    unsigned long uploaded_total;
+};
+
+/* fill the whole screen block with the area around the scroll position - the
+ * screen can be 0 for a game which is never drawn, the lines are still marked
+ * as they come into view but stream_draw must not be called */
+void stream_init(struct MapStream* stream, const unsigned short* tiles, int width,
+        int height, volatile unsigned short* screen, int xscroll, int yscroll);
+
+/* follow the camera, marking the columns and rows which come into view */
+void stream_update(struct MapStream* stream, int xscroll, int yscroll);
+
+/* write up to STREAM_BUDGET of the marked columns and rows, this must be called
+ * during vblank */
+void stream_draw(struct MapStream* stream);
+
+#endif
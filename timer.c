@@ -0,0 +1,141 @@
+/*
+ * timer.c
+ * countdowns kept on a hierarchical timer wheel
+ */
+
+#include "timer.h"
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+
+/* the frames each level can reach from now */
+#define TIMER_LEVEL_SPAN(level) (1u << (TIMER_SLOT_BITS * ((level) + 1)))
+
+void timer_wheel_init(struct TimerWheel* wheel) {
+    wheel->fired_total = 0;
+    wheel->cascaded_total = 0;
+    timer_wheel_clear(wheel);
+}
+
+void timer_wheel_clear(struct TimerWheel* wheel) {
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_SLOTS; slot++) {
+            wheel->slots[level][slot] = 0;
+        }
+    }
+    wheel->now = 0;
+}
+
+void timer_init(struct Timer* timer, void (*fire)(void* data), void* data) {
+    timer->next = 0;
+    timer->link = 0;
+    timer->expires = 0;
+    timer->pending = 0;
+    timer->fire = fire;
+    timer->data = data;
+}
+
+/* put a timer in the slot for when it expires - the lowest level whose span
+ * reaches it, the slot being the expiry frame's digit at that level */
+static void timer_insert(struct TimerWheel* wheel, struct Timer* timer) {
+    unsigned int delta = timer->expires - wheel->now;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= TIMER_LEVEL_SPAN(level)) {
+        level++;
+    }
+
+    /* too far off for the top level, so go as far as it reaches and be put
+     * back in when that slot comes round */
+    unsigned int when = timer->expires;
+    if (delta >= TIMER_LEVEL_SPAN(TIMER_LEVELS - 1)) {
+        when = wheel->now + TIMER_LEVEL_SPAN(TIMER_LEVELS - 1) - 1;
+    }
+
+    struct Timer** slot = &wheel->slots[level][(when >> (TIMER_SLOT_BITS * level)) & TIMER_MASK];
+    timer->next = *slot;
+    timer->link = slot;
+    if (*slot) {
+        (*slot)->link = &timer->next;
+    }
+    *slot = timer;
+}
+
+void timer_add(struct TimerWheel* wheel, struct Timer* timer, int frames) {
+    timer_cancel(timer);
+
+    /* the slot for now is being run out, so the soonest is the next frame */
+    if (frames < 1) {
+        frames = 1;
+    }
+    timer->expires = wheel->now + frames;
+    timer->pending = 1;
+    timer_insert(wheel, timer);
+}
+
+void timer_cancel(struct Timer* timer) {
+    if (!timer->pending) {
+        return;
+    }
+    *timer->link = timer->next;
+    if (timer->next) {
+        timer->next->link = timer->link;
+    }
+    timer->next = 0;
+    timer->link = 0;
+    timer->pending = 0;
+}
+
+/* take every timer out of a slot of an upper level and put it back in lower
+ * down, now that it is closer */
+static void timer_cascade(struct TimerWheel* wheel, int level) {
+    int index = (wheel->now >> (TIMER_SLOT_BITS * level)) & TIMER_MASK;
+    struct Timer* timer = wheel->slots[level][index];
+    wheel->slots[level][index] = 0;
+
+    while (timer) {
+        struct Timer* next = timer->next;
+        timer_insert(wheel, timer);
+        wheel->cascaded_total++;
+        timer = next;
+    }
+}
+
+void timer_wheel_tick(struct TimerWheel* wheel) {
+    wheel->now++;
+
+    /* each time a level wraps around, the next slot of the level above comes
+     * down - the highest first, so its timers can carry on down */
+    int wrapped = 0;
+    while (wrapped < TIMER_LEVELS - 1 &&
+            (wheel->now & (TIMER_LEVEL_SPAN(wrapped) - 1)) == 0) {
+        wrapped++;
+    }
+    for (int level = wrapped; level > 0; level--) {
+        timer_cascade(wheel, level);
+    }
+
+    /* move the slot's list out first, so a timer started again as it fires
+     * goes into a fresh list, and one cancelled by another's fire comes out
+     * of this one */
+    struct Timer** slot = &wheel->slots[0][wheel->now & TIMER_MASK];
+    struct Timer* due = *slot;
+    *slot = 0;
+    if (due) {
+        due->link = &due;
+    }
+
+    while (due) {
+        struct Timer* timer = due;
+        due = timer->next;
+        if (due) {
+            due->link = &due;
+        }
+
+        timer->next = 0;
+        timer->link = 0;
+        timer->pending = 0;
+        wheel->fired_total++;
+        if (timer->fire) {
+            timer->fire(timer->data);
+        }
+    }
+}
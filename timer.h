@@ -0,0 +1,71 @@
+/*
+ * timer.h
+ * countdowns kept on a hierarchical timer wheel, so a waiting timer costs
+ * nothing each frame until it runs out
+ */
+
+#pragma once
+#ifndef TIMER_H
+#define TIMER_H
+
+/* each level of the wheel has 64 slots, and each slot of a level covers all
+ * 64 slots of the level below - three levels reach 262144 frames (over an hour),
+ * and a timer further off than that waits in the top level until it is closer */
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 3
+
+/* a countdown, which is kept inside whatever it belongs to - while it is
+ * running pending is set, so it can be used as a flag, and when it runs out
+ * fire is called with data if it is set */
+struct Timer {
+    /* the next timer in the slot, and what points at this one - the slot or
+     * the timer before - so it can be taken out without knowing the slot */
+    struct Timer* next;
+    struct Timer** link;
+
+    unsigned int expires;
+    int pending;
+
+    void (*fire)(void* data);
+    void* data;
+};
+
+/* the running timers, each in the slot for when it runs out */
+struct TimerWheel {
+    struct Timer* slots[TIMER_LEVELS][TIMER_SLOTS];
+
+    /* the current frame */
+    unsigned int now;
+
+    /* the timers which ran out, and the ones moved down a level, in total */
+    unsigned long fired_total;
+    unsigned long cascaded_total;
+};
+
+/* set up an empty wheel at frame 0 */
+void timer_wheel_init(struct TimerWheel* wheel);
+
+/* empty a wheel and go back to frame 0, keeping its counts - every timer on it
+ * is forgotten, so their owners have to set them up again with timer_init */
+void timer_wheel_clear(struct TimerWheel* wheel);
+
+/* move on a frame, running out the timers due on it */
+void timer_wheel_tick(struct TimerWheel* wheel);
+
+/* set up a timer which isn't running, fire can be 0 */
+void timer_init(struct Timer* timer, void (*fire)(void* data), void* data);
+
+/* start a timer running out in frames (at least 1) from now, restarting it if
+ * it is already running */
+void timer_add(struct TimerWheel* wheel, struct Timer* timer, int frames);
+
+/* stop a timer without it firing, it's fine if it isn't running */
+void timer_cancel(struct Timer* timer);
+
+/* whether a timer is still running */
+static inline int timer_pending(const struct Timer* timer) {
+    return timer->pending;
+}
+
+#endif